@@ -5,6 +5,7 @@
 // y hace el backup dentro de un directorio que le pasamos por parámetro.
 
 #include "common.hpp"
+#include "pack.hpp"
 
 #include <iostream>
 #include <signal.h>
@@ -18,6 +19,16 @@
 // Se modifica desde los manejadores de señales de terminación.
 std::atomic<bool> quit_requested{false};
 
+// Responde al cliente. Con pidfd la señal va seguro al proceso que hizo la petición;
+// solo si el kernel no tiene pidfd (ENOSYS) usamos kill() como antes.
+static void notify_client(int client_pidfd, pid_t client_pid, int signo) {
+    if (client_pidfd != -1) {
+        send_signal_pidfd(client_pidfd, signo);
+    } else {
+        kill(client_pid, signo);
+    }
+}
+
 int main(int argc, char* argv[]) {
 
     // =============================
@@ -36,7 +47,7 @@ int main(int argc, char* argv[]) {
                 std::cerr << "backup-server: error: demasiados argumentos\n";
                 break;
         }
-        std::cerr << "uso: backup-server [-z | -j | -x] [DIRECTORIO_DESTINO]\n";
+        std::cerr << "uso: backup-server [-p] [-z | -j | -x | -a] [DIRECTORIO_DESTINO]\n";
         return 1;
     }
 
@@ -82,7 +93,17 @@ int main(int argc, char* argv[]) {
     // =============================
     // 5. Verificar comando de compresión si aplica
     // =============================
-    if (options.compression != CompressionType::NONE) {
+    bool fast_available = false;
+    bool strong_available = false;
+    if (options.compression == CompressionType::AUTO) {
+        fast_available = is_command_available(get_compression_command(CompressionType::GZIP));
+        strong_available = is_command_available(get_compression_command(CompressionType::XZ));
+        if (!fast_available && !strong_available) {
+            std::cerr << "backup-server: error: ni gzip ni xz están instalados\n";
+            return 1;
+        }
+        std::cout << "backup-server: compresión: automática según entropía\n";
+    } else if (options.compression != CompressionType::NONE) {
         std::string cmd = get_compression_command(options.compression);
         if (!is_command_available(cmd)) {
             std::cerr << "backup-server: error: " << cmd << " no está instalado\n";
@@ -94,22 +115,33 @@ int main(int argc, char* argv[]) {
     // =============================
     // 6. Comprobar si ya hay otro servidor corriendo
     // =============================
+    // El lock file queda bloqueado hasta que el proceso termine (aunque sea por SIGKILL)
     std::string pid_path = get_pid_file_path();
-    if (file_exists(pid_path)) {
-        auto maybe_pid = read_server_pid_from_file(pid_path);
-        if (maybe_pid.has_value()) {
-            pid_t pid = maybe_pid.value();
-            if (is_server_running(pid)) {
-                std::cerr << "backup-server: error: ya hay un servidor ejecutándose (PID "
-                          << pid << ")\n";
-                return 1;
-            } else {
-                std::cerr << "backup-server: aviso: existe pid-file pero el proceso no está vivo\n";
-            }
+    auto res_lock = acquire_server_lock(get_lock_file_path());
+    if (!res_lock.has_value()) {
+        if (res_lock.error().code().value() == EWOULDBLOCK) {
+            std::cerr << "backup-server: error: ya hay un servidor ejecutándose\n";
         } else {
-            std::cerr << "backup-server: aviso: no se pudo leer PID previo: "
-                      << maybe_pid.error().what() << "\n";
+            std::cerr << "backup-server: error: " << res_lock.error().what() << "\n";
         }
+        return 1;
+    }
+    int lock_fd = res_lock.value();
+
+    // =============================
+    // 6b. Abrir el pack si se pidió -p
+    // =============================
+    PackStore pack;
+    if (options.pack_small_files) {
+        auto res_pack = pack_open(backup_dir);
+        if (!res_pack.has_value()) {
+            std::cerr << "backup-server: error abriendo pack: "
+                      << res_pack.error().what() << "\n";
+            return 1;
+        }
+        pack = std::move(res_pack.value());
+        std::cout << "backup-server: modo pack: " << pack.index.size()
+                  << " entradas en " << get_pack_index_path(backup_dir) << "\n";
     }
 
     // =============================
@@ -169,10 +201,30 @@ int main(int argc, char* argv[]) {
     // =============================
     while (!quit_requested) {
         siginfo_t info;
-        int signo = sigwaitinfo(&sigset, &info);
+        int signo;
+        if (options.pack_small_files) {
+            // En modo pack esperamos con timeout para compactar cuando no hay peticiones
+            struct timespec timeout{PACK_IDLE_COMPACTION_SECONDS, 0};
+            signo = sigtimedwait(&sigset, &info, &timeout);
+        } else {
+            signo = sigwaitinfo(&sigset, &info);
+        }
 
         if (signo == -1) {
             if (errno == EINTR) continue;
+            if (errno == EAGAIN) {
+                if (pack_needs_compaction(pack)) {
+                    auto res_compact = pack_compact(pack);
+                    if (res_compact.has_value()) {
+                        std::cout << "backup-server: pack compactado ("
+                                  << pack.index.size() << " entradas)\n";
+                    } else {
+                        std::cerr << "backup-server: error compactando pack: "
+                                  << res_compact.error().what() << "\n";
+                    }
+                }
+                continue;
+            }
             std::cerr << "backup-server: sigwaitinfo error: " << strerror(errno) << "\n";
             break;
         }
@@ -191,6 +243,26 @@ int main(int argc, char* argv[]) {
                 continue;
             }
 
+            // Vigilamos al cliente con un pidfd: si muere, cancelamos su copia
+            // ESRCH: el cliente ya no existe y su PID podría estar reutilizado, así que
+            // no hay a quién responder. Solo sin soporte de pidfd (ENOSYS) seguimos con kill().
+            int client_pidfd = -1;
+            auto res_pidfd = open_process_fd(info.si_pid);
+            if (res_pidfd.has_value()) {
+                client_pidfd = res_pidfd.value();
+            } else if (res_pidfd.error().code().value() != ENOSYS) {
+                std::cerr << "backup-server: el cliente de " << origen
+                          << " no está disponible (" << res_pidfd.error().what()
+                          << "), se descarta la petición\n";
+                continue;
+            }
+            if (process_has_exited(client_pidfd)) {
+                std::cerr << "backup-server: el cliente de " << origen
+                          << " ya terminó, se descarta la petición\n";
+                close(client_pidfd);
+                continue;
+            }
+
             std::string nombre;
             size_t pos = origen.find_last_of('/');
             if (pos == std::string::npos) nombre = origen;
@@ -200,15 +272,46 @@ int main(int argc, char* argv[]) {
             if (destino.back() != '/') destino += '/';
             destino += nombre;
 
+            // Los archivos pequeños van al pack (sin comprimir: no compensa)
+            struct stat st_origen;
+            bool to_pack = options.pack_small_files &&
+                           stat(origen.c_str(), &st_origen) == 0 &&
+                           S_ISREG(st_origen.st_mode) &&
+                           static_cast<uint64_t>(st_origen.st_size) <= PACK_SMALL_FILE_THRESHOLD;
+
+            // En modo automático decidimos la compresión de este archivo muestreando su inicio
+            CompressionType compression = options.compression;
+            if (!to_pack && compression == CompressionType::AUTO) {
+                auto entropy = estimate_entropy(origen);
+                compression = entropy.has_value()
+                    ? choose_compression(entropy.value(), fast_available, strong_available)
+                    : CompressionType::NONE; // el error real lo dará la copia
+                if (entropy.has_value()) {
+                    std::string cmd = get_compression_command(compression);
+                    std::cout << "backup-server: entropía " << entropy.value()
+                              << " bits/byte -> " << (cmd.empty() ? "sin compresión" : cmd) << "\n";
+                }
+            }
+
             // Aplicar extensión si hay compresión
             std::expected<void, std::variant<std::system_error, CopyFileCompressedError>> res;
-            if (options.compression == CompressionType::NONE) {
-                res = copy_file(origen, destino);
+            if (to_pack) {
+                destino = get_pack_index_path(backup_dir) + ":" + origen;
+                auto res_pack = pack_add_file(pack, origen, origen);
+                if (!res_pack.has_value()) {
+                    res = std::unexpected(
+                        std::variant<std::system_error, CopyFileCompressedError>(
+                            res_pack.error()
+                        )
+                    );
+                }
+            } else if (compression == CompressionType::NONE) {
+                res = copy_file(origen, destino, client_pidfd);
             } else {
-                std::string ext = get_compression_extension(options.compression);
+                std::string ext = get_compression_extension(compression);
                 destino += ext;
-                std::string cmd = get_compression_command(options.compression);
-                auto res_comp = copy_file_compressed(origen, destino, cmd);
+                std::string cmd = get_compression_command(compression);
+                auto res_comp = copy_file_compressed(origen, destino, cmd, client_pidfd);
                 if (res_comp.has_value()) {
                     res = {}; // éxito
                 } else {
@@ -221,12 +324,15 @@ int main(int argc, char* argv[]) {
                 }
             }
 
-            // Enviar señal al cliente
-            pid_t cliente_pid = info.si_pid;
+            // Enviar señal al cliente por su pidfd (si el PID se hubiera reutilizado
+            // no le llegaría a otro proceso)
             if (res.has_value()) {
+                if (options.compression == CompressionType::AUTO && !to_pack) {
+                    record_compression_choice(destino, compression);
+                }
                 std::cout << "backup-server: backup completado: "
                           << origen << " -> " << destino << "\n";
-                kill(cliente_pid, SIGUSR1);
+                notify_client(client_pidfd, info.si_pid, SIGUSR1);
             } else {
                 std::string msg;
                 if (std::holds_alternative<CopyFileCompressedError>(res.error())) {
@@ -244,6 +350,9 @@ int main(int argc, char* argv[]) {
                         case CopyFileCompressedError::command_execution_failed:
                             msg = "el compresor falló durante la ejecución";
                             break;
+                        case CopyFileCompressedError::cancelled:
+                            msg = "el cliente terminó, copia cancelada";
+                            break;
                         default:
                             msg = "error desconocido en compresión";
                     }
@@ -251,17 +360,20 @@ int main(int argc, char* argv[]) {
                     msg = std::get<std::system_error>(res.error()).what();
                 }
                 std::cerr << "backup-server: error copiando " << origen << ": " << msg << "\n";
-                kill(cliente_pid, SIGUSR2);
+                notify_client(client_pidfd, info.si_pid, SIGUSR2);
             }
+            if (client_pidfd != -1) close(client_pidfd);
         }
     }
 
     // =============================
     // 12. Limpieza
     // =============================
+    pack_close(pack);
     close(fifo_fd);
     unlink(fifo_path.c_str());
     unlink(pid_path.c_str());
+    close(lock_fd);
 
     return 0;
 }
@@ -270,3 +382,5 @@ int main(int argc, char* argv[]) {
 //export BACKUP_WORK_DIR=~/UNI/1Cuatri_2º/SSOO/practica_sockets/segunda_entrega/work-backup/
 //./backup-server ~/UNI/1Cuatri_2º/SSOO/practica_sockets/segunda_entrega/backups/
 //./backup-server -z ~/backups
+//./backup-server -p ~/backups
+//./backup-server -a ~/backups
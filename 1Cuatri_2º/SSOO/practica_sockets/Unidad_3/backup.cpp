@@ -8,6 +8,7 @@
 #include <sys/types.h>
 #include <fcntl.h>
 #include <cstring>
+#include <poll.h>
 
 // =============================
 // MODI: variable global para recibir señal
@@ -57,9 +58,15 @@ int main(int argc, char* argv[]) {
     }
 
     // =============================
-    // 4. Leer PID del servidor desde pid-file
+    // 4. Comprobar el lock del servidor y leer su PID desde pid-file
     // =============================
 
+    std::string lock_path = get_lock_file_path();
+    if (!is_server_running(lock_path)) {
+        std::cerr << "backup: error: el servidor no está ejecutándose\n";
+        return 1;
+    }
+
     std::string pid_path = get_pid_file_path();
     auto maybe_pid = read_server_pid_from_file(pid_path);
 
@@ -71,10 +78,14 @@ int main(int argc, char* argv[]) {
 
     pid_t server_pid = maybe_pid.value();
 
-    if (!is_server_running(server_pid)) {
+    // Abrimos un pidfd del servidor. Volvemos a mirar el lock después: si sigue
+    // bloqueado, el PID que hemos abierto es el del servidor vivo y no uno reutilizado.
+    auto maybe_pidfd = open_process_fd(server_pid);
+    if (!maybe_pidfd.has_value() || !is_server_running(lock_path)) {
         std::cerr << "backup: error: el servidor no está ejecutándose\n";
         return 1;
     }
+    int server_pidfd = maybe_pidfd.value();
 
     // =============================
     // MODI: instalar manejadores para recibir resultado
@@ -86,6 +97,15 @@ int main(int argc, char* argv[]) {
     sigaction(SIGUSR1, &sa, nullptr);
     sigaction(SIGUSR2, &sa, nullptr);
 
+    // Las dejamos bloqueadas hasta el ppoll() final para no perder la respuesta
+    sigset_t result_set, wait_mask;
+    sigemptyset(&result_set);
+    sigaddset(&result_set, SIGUSR1);
+    sigaddset(&result_set, SIGUSR2);
+    sigprocmask(SIG_BLOCK, &result_set, &wait_mask);
+    sigdelset(&wait_mask, SIGUSR1);
+    sigdelset(&wait_mask, SIGUSR2);
+
     // =============================
     // 5. Bloquear SIGPIPE para FIFO rota
     // =============================
@@ -146,7 +166,7 @@ int main(int argc, char* argv[]) {
     // =============================
     // 9. Enviar señal SIGUSR1 al servidor
     // =============================
-    if (kill(server_pid, SIGUSR1) == -1) {
+    if (send_signal_pidfd(server_pidfd, SIGUSR1) == -1) {
         std::cerr << "backup: error enviando señal al servidor: "
                   << strerror(errno) << "\n";
         close(fifo_fd);
@@ -156,22 +176,30 @@ int main(int argc, char* argv[]) {
     // =============================
     // MODI: esperar resultado del servidor
     // =============================
-    off_t file_size = lseek(open(archivo.c_str(), O_RDONLY), 0, SEEK_END);
-    close(open(archivo.c_str(), O_RDONLY));
-    if (file_size < 0) file_size = 1; // evitar 0
-    unsigned int wait_time = static_cast<unsigned int>(file_size / 1024 + 1); // segundos aproximados
-    unsigned int slept = 0;
-    while (slept < wait_time && backup_result == 0) {
-        sleep(1);
-        slept++;
+    // En vez de dormir a intervalos, ppoll() despierta justo cuando llega SIGUSR1/SIGUSR2
+    // o cuando el pidfd se vuelve legible porque el servidor ha muerto.
+    struct stat st;
+    off_t file_size = (stat(archivo.c_str(), &st) == 0) ? st.st_size : 1;
+    struct timespec timeout{static_cast<time_t>(file_size / 1024 + 1), 0}; // segundos aproximados
+    struct pollfd pfd{server_pidfd, POLLIN, 0};
+    bool server_died = false;
+
+    while (backup_result == 0) {
+        int r = ppoll(&pfd, 1, &timeout, &wait_mask);
+        if (r == -1 && errno == EINTR) continue; // ha llegado la respuesta
+        if (r == 1) server_died = true;
+        break;                                   // timeout, error o servidor muerto
     }
 
     close(fifo_fd);
+    close(server_pidfd);
 
     if (backup_result == 1) {
         std::cout << "backup: archivo " << path_abs << " respaldado correctamente\n";
     } else if (backup_result == 2) {
         std::cout << "backup: error al respaldar " << path_abs << "\n";
+    } else if (server_died) {
+        std::cout << "backup: el servidor terminó sin responder\n";
     } else {
         std::cout << "backup: tiempo de espera excedido sin respuesta del servidor\n";
     }
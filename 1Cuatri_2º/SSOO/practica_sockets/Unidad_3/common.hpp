@@ -24,7 +24,16 @@
 #include <sstream>
 #include <pwd.h>
 #include <sys/wait.h>
+#include <sys/xattr.h>
+#include <sys/file.h>
+#include <sys/syscall.h>
+#include <poll.h>
 #include <pthread.h>
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+
+#include "../checkpoint.hpp"
 
 // Tamaño del buffer usado para copiar archivos (64KiB).
 constexpr size_t COPY_BUFFER_SIZE = 64 * 1024;
@@ -57,6 +66,15 @@ inline std::string get_pid_file_path() {
 }
 
 
+// Devuelve la ruta al fichero de bloqueo: mientras el servidor vive lo tiene bloqueado con flock()
+inline std::string get_lock_file_path() {
+    std::string wd = get_work_dir_path();
+    if (wd.empty()) return std::string();
+    if (wd.back() == '/') wd.pop_back();
+    return wd + "/backup-server.lock";
+}
+
+
 // Comprueba si un archivo existe usando access()
 inline bool file_exists(const std::string& path) {
     return (access(path.c_str(), F_OK) == 0);
@@ -92,12 +110,53 @@ inline std::expected<std::string, std::system_error> get_absolute_path(const std
 }
 
 
+// Abre un pidfd: un descriptor que sigue apuntando al mismo proceso aunque su PID se reutilice.
+// Se vuelve legible (POLLIN) cuando el proceso termina.
+// Usamos syscall() directamente: el <sys/pidfd.h> de algunas glibc no se puede usar desde C++.
+inline std::expected<int, std::system_error> open_process_fd(pid_t pid) {
+    int fd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+    if (fd == -1) {
+        return std::unexpected(std::system_error(errno, std::system_category(), "error en pidfd_open"));
+    }
+    return fd;
+}
+
+
+// Envía una señal al proceso del pidfd (equivalente a kill() pero sin carreras de PID)
+inline int send_signal_pidfd(int pidfd, int signo) {
+    return static_cast<int>(syscall(SYS_pidfd_send_signal, pidfd, signo, nullptr, 0));
+}
+
+
+// Comprueba sin bloquear si el proceso del pidfd ya ha terminado
+inline bool process_has_exited(int pidfd) {
+    if (pidfd == -1) return false;
+    struct pollfd pfd{pidfd, POLLIN, 0};
+    return poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLIN);
+}
+
+
+// =============================
+// Checkpoints para copias reanudables
+// =============================
+// Los archivos grandes se copian dejando cada CHECKPOINT_INTERVAL bytes un
+// registro en DESTINO.checkpoint con el hash del tramo ya sincronizado
+// (ver checkpoint.hpp). Si el servidor muere a mitad, la siguiente petición del
+// mismo archivo comprueba esos tramos en el destino y continúa desde el último
+// que cuadra en vez de empezar de cero.
+
+
 // =============================
 // copy_file()
 // =============================
 // Copia un archivo usando únicamente open/read/write/close tal y como pide la práctica.
 // Si hay cualquier error devuelve std::unexpected con system_error.
-inline std::expected<void, std::system_error> copy_file(const std::string& src_path, const std::string& dest_path) {
+// Si se pasa cancel_pidfd y ese proceso muere durante la copia, se aborta con ECANCELED
+// y se borra el destino a medias.
+// Los archivos de CHECKPOINT_INTERVAL o más se copian con checkpoints y se reanudan
+// si una copia anterior quedó a medias.
+inline std::expected<void, std::system_error> copy_file(const std::string& src_path, const std::string& dest_path,
+                                                        int cancel_pidfd = -1) {
     std::vector<char> buffer(COPY_BUFFER_SIZE);
 
     // Abrimos origen solo lectura
@@ -106,13 +165,31 @@ inline std::expected<void, std::system_error> copy_file(const std::string& src_p
         return std::unexpected(std::system_error(errno, std::system_category(), "error al abrir origen"));
     }
 
-    // Abrimos destino en modo crear/truncar
-    int dest_fd = open(dest_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    struct stat src_st;
+    if (fstat(src_fd, &src_st) == -1) {
+        close(src_fd);
+        return std::unexpected(std::system_error(errno, std::system_category(), "error en fstat del origen"));
+    }
+    bool resumable = static_cast<uint64_t>(src_st.st_size) >= CHECKPOINT_INTERVAL;
+
+    // Abrimos destino en modo crear/truncar (sin truncar si puede haber algo que reanudar)
+    int dest_fd = open(dest_path.c_str(), resumable ? (O_RDWR | O_CREAT) : (O_WRONLY | O_CREAT | O_TRUNC), 0666);
     if (dest_fd == -1) {
         close(src_fd);
         return std::unexpected(std::system_error(errno, std::system_category(), "error al abrir destino"));
     }
 
+    const SourceVersion src_version = source_version(src_st);
+    CheckpointState checkpoint;
+    if (resumable) checkpoint = load_checkpoint(dest_path, dest_fd, src_version);
+    uint64_t offset = checkpoint.offset;
+    if (lseek(src_fd, offset, SEEK_SET) == -1 || lseek(dest_fd, offset, SEEK_SET) == -1) {
+        close(src_fd);
+        close(dest_fd);
+        return std::unexpected(std::system_error(errno, std::system_category(), "error en lseek"));
+    }
+    StreamHash window_hash;
+
     // Bucle clásico de lectura-escritura
     while (true) {
         ssize_t br = read(src_fd, buffer.data(), buffer.size());
@@ -124,6 +201,14 @@ inline std::expected<void, std::system_error> copy_file(const std::string& src_p
         }
         if (br == 0) break; // EOF
 
+        if (process_has_exited(cancel_pidfd)) {
+            close(src_fd);
+            close(dest_fd);
+            unlink(dest_path.c_str());
+            unlink(get_checkpoint_path(dest_path).c_str());
+            return std::unexpected(std::system_error(ECANCELED, std::system_category(), "el cliente terminó"));
+        }
+
         // Escribimos teniendo en cuenta que write puede escribir menos bytes
         ssize_t written = 0;
         while (written < br) {
@@ -136,6 +221,31 @@ inline std::expected<void, std::system_error> copy_file(const std::string& src_p
             }
             written += bw;
         }
+
+        if (resumable) {
+            window_hash.update(buffer.data(), br);
+            offset += br;
+            if (offset - checkpoint.offset >= CHECKPOINT_INTERVAL) {
+                auto res = save_checkpoint(dest_path, dest_fd, src_version, checkpoint,
+                                           offset, window_hash.digest());
+                if (!res.has_value()) {
+                    close(src_fd);
+                    close(dest_fd);
+                    return res;
+                }
+                window_hash = StreamHash();
+            }
+        }
+    }
+
+    if (resumable) {
+        // El destino podía ser más largo que el origen actual
+        if (ftruncate(dest_fd, offset) == -1) {
+            close(src_fd);
+            close(dest_fd);
+            return std::unexpected(std::system_error(errno, std::system_category(), "error ajustando tamaño destino"));
+        }
+        unlink(get_checkpoint_path(dest_path).c_str());
     }
 
     // Cerramos descriptores
@@ -208,13 +318,32 @@ inline std::expected<pid_t, std::system_error> read_server_pid_from_file(const s
 }
 
 
-// Comprueba si un proceso está vivo: kill(pid,0) no mata nada, solo prueba existencia del proceso
-inline bool is_server_running(pid_t pid) {
-    if (kill(pid, 0) == -1) {
-        if (errno == ESRCH) return false;  // no existe
-        return true;                        // EPERM → existe pero no tenemos permisos
+// Comprueba si hay un servidor vivo mirando el bloqueo del lock file.
+// El kernel suelta el flock() en cuanto el proceso muere, así que no hay PIDs
+// reutilizados ni pid-files viejos que nos engañen.
+inline bool is_server_running(const std::string& lock_path) {
+    int fd = open(lock_path.c_str(), O_RDONLY);
+    if (fd == -1) return false;  // sin lock file nunca ha arrancado un servidor
+    bool running = (flock(fd, LOCK_SH | LOCK_NB) == -1 && errno == EWOULDBLOCK);
+    close(fd);
+    return running;
+}
+
+
+// Bloquea el lock file para este servidor. El descriptor debe quedarse abierto
+// mientras el servidor vive. Si otro servidor lo tiene, devuelve EWOULDBLOCK.
+inline std::expected<int, std::system_error> acquire_server_lock(const std::string& lock_path) {
+    int fd = open(lock_path.c_str(), O_RDONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        return std::unexpected(std::system_error(errno, std::system_category(), "error abriendo lock file"));
     }
-    return true;
+    while (flock(fd, LOCK_EX | LOCK_NB) == -1) {
+        if (errno == EINTR) continue;
+        int err = errno;
+        close(fd);
+        return std::unexpected(std::system_error(err, std::system_category(), "error bloqueando lock file"));
+    }
+    return fd;
 }
 
 
@@ -291,12 +420,23 @@ enum class CompressionType {
     NONE,
     GZIP,   // -z
     BZIP2,  // -j
-    XZ      // -x
+    XZ,     // -x
+    AUTO    // -a: se elige para cada archivo según su entropía
 };
 
+// Muestra usada por el modo automático: los primeros bloques del archivo (256KiB)
+constexpr size_t ENTROPY_SAMPLE_BLOCKS = 4;
+
+// Umbrales en bits por byte. Por encima de INCOMPRESSIBLE el archivo ya está
+// comprimido (multimedia, .zip...) y no merece la pena gastar CPU; por debajo de
+// HIGHLY_COMPRESSIBLE (texto, logs...) compensa el compresor fuerte.
+constexpr double ENTROPY_INCOMPRESSIBLE = 7.5;
+constexpr double ENTROPY_HIGHLY_COMPRESSIBLE = 5.0;
+
 // Opciones del servidor
 struct ServerOptions {
     CompressionType compression = CompressionType::NONE;
+    bool pack_small_files = false;  // -p: archivos pequeños dentro de segmentos pack
     std::string backup_dir;
 };
 
@@ -315,9 +455,21 @@ enum class CopyFileCompressedError {
     output_access_denied,        // código 128
     process_creation_failed,     // fork() falló
     pipe_creation_failed,        // pipe() falló
+    cancelled,                   // el cliente murió durante la copia
     unknown_error                // otro error
 };
 
+// Resultado de alimentar la tubería del compresor con splice()
+enum class SpliceResult {
+    done,          // se copió todo el archivo
+    unsupported,   // el origen no admite splice(): usar read/write
+    failed,        // error a mitad de copia (p.ej. el compresor murió)
+    cancelled      // el proceso vigilado terminó: abandonamos la copia
+};
+
+// Bytes que pedimos a cada splice() y tamaño de la tubería hacia el compresor (1MiB)
+constexpr size_t SPLICE_CHUNK_SIZE = 1024 * 1024;
+
 // ================================
 // DECLARACIONES DE FUNCIONES
 // ================================
@@ -331,10 +483,19 @@ std::string get_compression_extension(CompressionType comp);
 
 bool is_command_available(const std::string& command);
 
+std::expected<double, std::system_error> estimate_entropy(const std::string& path);
+
+CompressionType choose_compression(double entropy, bool fast_available, bool strong_available);
+
+void record_compression_choice(const std::string& dest_path, CompressionType comp);
+
+SpliceResult splice_file_to_pipe(int src_fd, int pipe_fd, int cancel_pidfd = -1);
+
 std::expected<void, CopyFileCompressedError>
 copy_file_compressed(const std::string& src_path,
                      const std::string& dest_path,
-                     const std::string& compression_command);
+                     const std::string& compression_command,
+                     int cancel_pidfd = -1);
 
 // ================================
 // IMPLEMENTACIONES (header-only)
@@ -353,11 +514,15 @@ parse_arguments(int argc, char* argv[]) {
     opterr = 0; // desactivar mensajes automáticos
 
     int opt;
-    while ((opt = getopt(argc, argv, "zjx")) != -1) {
+    while ((opt = getopt(argc, argv, "zjxap")) != -1) {
         switch (opt) {
+            case 'p':
+                opts.pack_small_files = true;
+                break;
             case 'z':
             case 'j':
             case 'x':
+            case 'a':
                 if (comp_set) {
                     return std::unexpected(ParseArgsErrors::multiple_compression_options);
                 }
@@ -365,6 +530,7 @@ parse_arguments(int argc, char* argv[]) {
                 if (opt == 'z') opts.compression = CompressionType::GZIP;
                 else if (opt == 'j') opts.compression = CompressionType::BZIP2;
                 else if (opt == 'x') opts.compression = CompressionType::XZ;
+                else if (opt == 'a') opts.compression = CompressionType::AUTO;
                 break;
             case '?':
             default:
@@ -401,15 +567,68 @@ std::string get_compression_extension(CompressionType comp) {
     }
 }
 
+// Estima la entropía (bits por byte, entre 0 y 8) de los primeros bloques del archivo
+// a partir del histograma de bytes. Es mucho más barato que comprimir de prueba y
+// basta para distinguir texto de datos ya comprimidos.
+std::expected<double, std::system_error> estimate_entropy(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return std::unexpected(std::system_error(errno, std::system_category(), "error al abrir origen"));
+    }
+
+    std::vector<unsigned char> buffer(COPY_BUFFER_SIZE);
+    uint64_t histogram[256] = {0};
+    uint64_t total = 0;
+
+    size_t blocks = 0;
+    while (blocks < ENTROPY_SAMPLE_BLOCKS) {
+        ssize_t br = read(fd, buffer.data(), buffer.size());
+        if (br == -1) {
+            if (errno == EINTR) continue;
+            close(fd);
+            return std::unexpected(std::system_error(errno, std::system_category(), "error lectura origen"));
+        }
+        if (br == 0) break; // EOF
+        for (ssize_t i = 0; i < br; i++) histogram[buffer[i]]++;
+        total += br;
+        blocks++;
+    }
+    close(fd);
+
+    if (total == 0) return 0.0;
+
+    double entropy = 0.0;
+    for (uint64_t count : histogram) {
+        if (count == 0) continue;
+        double p = static_cast<double>(count) / total;
+        entropy -= p * std::log2(p);
+    }
+    return entropy;
+}
+
+// Elige el compresor a partir de la entropía: ninguno, rápido (gzip) o fuerte (xz).
+// Si el elegido no está instalado usamos el otro, y si no hay ninguno, sin compresión.
+CompressionType choose_compression(double entropy, bool fast_available, bool strong_available) {
+    if (entropy >= ENTROPY_INCOMPRESSIBLE) return CompressionType::NONE;
+    if (entropy < ENTROPY_HIGHLY_COMPRESSIBLE && strong_available) return CompressionType::XZ;
+    if (fast_available) return CompressionType::GZIP;
+    if (strong_available) return CompressionType::XZ;
+    return CompressionType::NONE;
+}
+
+// Guarda la compresión usada como atributo extendido del backup (user.backup.compression).
+// Si el sistema de archivos no soporta xattrs no pasa nada: la extensión ya lo indica.
+void record_compression_choice(const std::string& dest_path, CompressionType comp) {
+    std::string value = get_compression_command(comp);
+    if (value.empty()) value = "none";
+    setxattr(dest_path.c_str(), "user.backup.compression", value.data(), value.size(), 0);
+}
+
 bool is_command_available(const std::string& command) {
     const char* path_env = getenv("PATH");
     if (!path_env) return false;
 
     std::string paths(path_env);
-#include <system_error>
-#include <sys/stat.h>
-#include <unistd.h>
-#inclu
     std::istringstream ss(paths);
     std::string dir;
 
@@ -422,14 +641,37 @@ bool is_command_available(const std::string& command) {
     return false;
 }
 
+// Pasa todo src_fd a la tubería con splice(), sin copiar los datos a memoria de usuario.
+// Devuelve unsupported si el primer splice() falla porque el origen no lo admite,
+// para que el llamador use el bucle read/write de siempre.
+SpliceResult splice_file_to_pipe(int src_fd, int pipe_fd, int cancel_pidfd) {
+    bool first = true;
+    while (true) {
+        if (process_has_exited(cancel_pidfd)) return SpliceResult::cancelled;
+        ssize_t n = splice(src_fd, nullptr, pipe_fd, nullptr, SPLICE_CHUNK_SIZE,
+                           SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            if (first && (errno == EINVAL || errno == ENOSYS)) return SpliceResult::unsupported;
+            return SpliceResult::failed;
+        }
+        if (n == 0) return SpliceResult::done; // EOF
+        first = false;
+    }
+}
+
 std::expected<void, CopyFileCompressedError>
 copy_file_compressed(const std::string& src_path,
                      const std::string& dest_path,
-                     const std::string& compression_command) {
+                     const std::string& compression_command,
+                     int cancel_pidfd) {
     int pipefd[2];
     if (pipe(pipefd) == -1) {
         return std::unexpected(CopyFileCompressedError::pipe_creation_failed);
     }
+    // Tubería más grande: menos cambios de contexto con el compresor.
+    // Si no se puede (límite de /proc/sys/fs/pipe-max-size) seguimos con la de 64KiB.
+    fcntl(pipefd[1], F_SETPIPE_SZ, static_cast<int>(SPLICE_CHUNK_SIZE));
 
     pid_t pid = fork();
     if (pid == -1) {
@@ -467,10 +709,6 @@ copy_file_compressed(const std::string& src_path,
         // PADRE
         close(pipefd[0]);
 
-#include <system_error>
-#include <sys/stat.h>
-#include <unistd.h>
-#inclu
         sigset_t oldset, newset;
         sigemptyset(&newset);
         sigaddset(&newset, SIGPIPE);
@@ -485,20 +723,23 @@ copy_file_compressed(const std::string& src_path,
             return std::unexpected(CopyFileCompressedError::unknown_error);
         }
 
-        std::vector<char> buffer(COPY_BUFFER_SIZE);
-        bool write_error = false;
-#include <system_error>
-#include <sys/stat.h>
-#include <unistd.h>
-#inclu
+        // Primero intentamos mover los datos a la tubería dentro del kernel con splice()
+        SpliceResult feed = splice_file_to_pipe(src_fd, pipefd[1], cancel_pidfd);
+        bool write_error = (feed == SpliceResult::failed);
 
-        while (true) {
+        // Si el origen no admite splice(), bucle clásico de lectura-escritura
+        std::vector<char> buffer(feed == SpliceResult::unsupported ? COPY_BUFFER_SIZE : 0);
+        while (feed == SpliceResult::unsupported) {
             ssize_t br = read(src_fd, buffer.data(), buffer.size());
             if (br == -1) {
                 if (errno == EINTR) continue;
                 break;
             }
             if (br == 0) break;
+            if (process_has_exited(cancel_pidfd)) {
+                feed = SpliceResult::cancelled;
+                break;
+            }
 
             ssize_t written = 0;
             while (written < br) {
@@ -517,10 +758,14 @@ copy_file_compressed(const std::string& src_path,
         close(pipefd[1]);
         pthread_sigmask(SIG_SETMASK, &oldset, nullptr);
 
-#include <system_error>
-#include <sys/stat.h>
-#include <unistd.h>
-#inclu
+        // Cliente muerto: paramos el compresor y no dejamos un backup a medias
+        if (feed == SpliceResult::cancelled) {
+            kill(pid, SIGTERM);
+            waitpid(pid, nullptr, 0);
+            unlink(dest_path.c_str());
+            return std::unexpected(CopyFileCompressedError::cancelled);
+        }
+
         int status;
         if (waitpid(pid, &status, 0) == -1) {
             return std::unexpected(CopyFileCompressedError::unknown_error);
@@ -0,0 +1,508 @@
+// pack.hpp
+// Modo "pack" del servidor de backups.
+// En vez de crear un fichero por cada archivo pequeño dentro de backup_dir,
+// los vamos añadiendo al final de ficheros de segmento grandes (pack-NNNNNN.seg)
+// y guardamos un índice (pack.idx) con ruta → (segmento, offset, tamaño).
+// En memoria el índice está ordenado por ruta, así que buscar una entrada es
+// una búsqueda binaria y leerla es un único pread().
+
+#ifndef PACK_HPP
+#define PACK_HPP
+
+#include "common.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Archivos de este tamaño o menores se guardan dentro del pack (256KiB).
+constexpr uint64_t PACK_SMALL_FILE_THRESHOLD = 256 * 1024;
+
+// Tamaño máximo de cada segmento antes de pasar al siguiente (64MiB).
+constexpr uint64_t PACK_SEGMENT_MAX_SIZE = 64 * 1024 * 1024;
+
+// Segundos sin peticiones tras los que el servidor intenta compactar.
+constexpr int PACK_IDLE_COMPACTION_SECONDS = 5;
+
+// Cabecera de cada registro del índice. Detrás va la ruta (path_len bytes).
+struct PackIndexRecord {
+    uint32_t path_len;
+    uint32_t segment;
+    uint64_t offset;
+    uint64_t size;
+};
+
+// Una entrada del índice en memoria
+struct PackEntry {
+    std::string path;
+    uint32_t segment;
+    uint64_t offset;
+    uint64_t size;
+};
+
+// Estado del pack abierto por el servidor
+struct PackStore {
+    std::string dir;
+    std::vector<PackEntry> index;   // ordenado por path
+    uint32_t first_segment = 0;     // segmento más bajo que puede quedar en disco
+    uint32_t current_segment = 0;
+    uint64_t current_segment_size = 0;
+    uint64_t live_bytes = 0;        // bytes de entradas vigentes
+    uint64_t dead_bytes = 0;        // bytes de entradas sustituidas por otras más nuevas
+    int index_fd = -1;              // -1: pack cerrado o inutilizable
+};
+
+
+inline std::string get_pack_index_path(const std::string& dir) {
+    std::string d = dir;
+    if (!d.empty() && d.back() == '/') d.pop_back();
+    return d + "/pack.idx";
+}
+
+
+inline std::string get_pack_segment_path(const std::string& dir, uint32_t segment) {
+    std::string d = dir;
+    if (!d.empty() && d.back() == '/') d.pop_back();
+    char name[32];
+    snprintf(name, sizeof(name), "/pack-%06u.seg", segment);
+    return d + name;
+}
+
+
+// Escribe todo el buffer teniendo en cuenta escrituras parciales y EINTR
+inline std::expected<void, std::system_error> write_all(int fd, const char* buf, size_t len) {
+    size_t written = 0;
+    while (written < len) {
+        ssize_t w = write(fd, buf + written, len - written);
+        if (w == -1) {
+            if (errno == EINTR) continue;
+            return std::unexpected(std::system_error(errno, std::system_category(), "error escribiendo"));
+        }
+        written += w;
+    }
+    return {};
+}
+
+
+// Escribe todo el buffer en offset (pwrite puede escribir menos)
+inline std::expected<void, std::system_error> pwrite_all(int fd, const char* buf, size_t len, off_t offset) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t w = pwrite(fd, buf + done, len - done, offset + done);
+        if (w == -1) {
+            if (errno == EINTR) continue;
+            return std::unexpected(std::system_error(errno, std::system_category(), "error escribiendo"));
+        }
+        done += w;
+    }
+    return {};
+}
+
+
+// Lee exactamente len bytes desde offset (pread puede devolver menos)
+inline std::expected<void, std::system_error> pread_all(int fd, char* buf, size_t len, off_t offset) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t r = pread(fd, buf + done, len - done, offset + done);
+        if (r == -1) {
+            if (errno == EINTR) continue;
+            return std::unexpected(std::system_error(errno, std::system_category(), "error leyendo segmento"));
+        }
+        if (r == 0) {
+            return std::unexpected(std::system_error(EIO, std::system_category(), "segmento truncado"));
+        }
+        done += r;
+    }
+    return {};
+}
+
+
+// fsync del directorio del pack: hace duraderas las entradas creadas o
+// renombradas en él (segmentos nuevos, rename() del índice)
+inline std::expected<void, std::system_error> pack_sync_dir(const std::string& dir) {
+    int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd == -1) {
+        return std::unexpected(std::system_error(errno, std::system_category(), "error abriendo directorio del pack"));
+    }
+    int r = fsync(fd);
+    int err = errno;
+    close(fd);
+    if (r == -1) {
+        return std::unexpected(std::system_error(err, std::system_category(), "error en fsync del directorio del pack"));
+    }
+    return {};
+}
+
+
+// Busca la entrada de una ruta en el índice ordenado. nullptr si no está.
+inline const PackEntry* pack_find(const PackStore& pack, const std::string& path) {
+    auto it = std::lower_bound(pack.index.begin(), pack.index.end(), path,
+        [](const PackEntry& e, const std::string& p) { return e.path < p; });
+    if (it == pack.index.end() || it->path != path) return nullptr;
+    return &*it;
+}
+
+
+// Inserta o sustituye una entrada manteniendo el índice ordenado.
+// Si ya existía, sus bytes pasan a contarse como espacio muerto.
+inline void pack_index_insert(PackStore& pack, PackEntry entry) {
+    auto it = std::lower_bound(pack.index.begin(), pack.index.end(), entry.path,
+        [](const PackEntry& e, const std::string& p) { return e.path < p; });
+    pack.live_bytes += entry.size;
+    if (it != pack.index.end() && it->path == entry.path) {
+        pack.live_bytes -= it->size;
+        pack.dead_bytes += it->size;
+        *it = std::move(entry);
+    } else {
+        pack.index.insert(it, std::move(entry));
+    }
+}
+
+
+// Serializa un registro del índice (cabecera + ruta) en un solo buffer
+inline std::vector<char> pack_encode_record(const PackEntry& e) {
+    PackIndexRecord rec{static_cast<uint32_t>(e.path.size()), e.segment, e.offset, e.size};
+    std::vector<char> buf(sizeof(rec) + e.path.size());
+    memcpy(buf.data(), &rec, sizeof(rec));
+    memcpy(buf.data() + sizeof(rec), e.path.data(), e.path.size());
+    return buf;
+}
+
+
+// Abre (o crea) el pack dentro de dir.
+// El fichero de índice es un registro en el que solo se añade al final; al cargarlo
+// la última entrada de cada ruta es la buena y las anteriores cuentan como espacio muerto.
+inline std::expected<PackStore, std::system_error> pack_open(const std::string& dir) {
+    PackStore pack;
+    pack.dir = dir;
+
+    std::string idx_path = get_pack_index_path(dir);
+    int fd = open(idx_path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (fd == -1) {
+        return std::unexpected(std::system_error(errno, std::system_category(), "error abriendo índice del pack"));
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return std::unexpected(std::system_error(errno, std::system_category(), "error en fstat del índice"));
+    }
+
+    std::vector<char> data(st.st_size);
+    if (!data.empty()) {
+        auto r = pread_all(fd, data.data(), data.size(), 0);
+        if (!r.has_value()) {
+            close(fd);
+            return std::unexpected(r.error());
+        }
+    }
+
+    size_t pos = 0;
+    while (pos + sizeof(PackIndexRecord) <= data.size()) {
+        PackIndexRecord rec;
+        memcpy(&rec, data.data() + pos, sizeof(rec));
+        if (pos + sizeof(rec) + rec.path_len > data.size()) break; // registro a medias
+        PackEntry e{std::string(data.data() + pos + sizeof(rec), rec.path_len),
+                    rec.segment, rec.offset, rec.size};
+        pos += sizeof(rec) + rec.path_len;
+        pack.current_segment = std::max(pack.current_segment, e.segment);
+        pack_index_insert(pack, std::move(e));
+    }
+
+    // Si el último registro quedó a medias (caída del servidor), lo descartamos
+    if (pos != data.size() && ftruncate(fd, pos) == -1) {
+        close(fd);
+        return std::unexpected(std::system_error(errno, std::system_category(), "error truncando índice"));
+    }
+
+    // Segmentos sin ninguna entrada en el índice: los de encima del último
+    // son de una compactación que no llegó al rename(), y los de debajo del
+    // primero, de una que cayó mientras borraba los antiguos. Ambos son contiguos.
+    uint32_t first_segment = pack.current_segment;
+    for (const PackEntry& e : pack.index) first_segment = std::min(first_segment, e.segment);
+    for (uint32_t s = pack.current_segment + 1;
+         unlink(get_pack_segment_path(dir, s).c_str()) == 0; s++) {
+    }
+    for (uint32_t s = first_segment;
+         s > 0 && unlink(get_pack_segment_path(dir, s - 1).c_str()) == 0; s--) {
+    }
+    pack.first_segment = first_segment;
+
+    std::string seg_path = get_pack_segment_path(dir, pack.current_segment);
+    if (stat(seg_path.c_str(), &st) == 0) {
+        pack.current_segment_size = st.st_size;
+    }
+
+    pack.index_fd = fd;
+    return pack;
+}
+
+
+inline void pack_close(PackStore& pack) {
+    if (pack.index_fd != -1) {
+        close(pack.index_fd);
+        pack.index_fd = -1;
+    }
+}
+
+
+// Añade el contenido de src_path al segmento actual y registra la entrada con la clave path
+inline std::expected<void, std::system_error>
+pack_add_file(PackStore& pack, const std::string& path, const std::string& src_path) {
+    if (pack.index_fd == -1) {
+        return std::unexpected(std::system_error(EBADF, std::system_category(), "pack inutilizable"));
+    }
+
+    int src_fd = open(src_path.c_str(), O_RDONLY);
+    if (src_fd == -1) {
+        return std::unexpected(std::system_error(errno, std::system_category(), "error al abrir origen"));
+    }
+
+    struct stat st;
+    if (fstat(src_fd, &st) == -1) {
+        close(src_fd);
+        return std::unexpected(std::system_error(errno, std::system_category(), "error en fstat del origen"));
+    }
+
+    // Leemos el archivo entero: solo entran aquí archivos pequeños
+    std::vector<char> data(st.st_size);
+    size_t total = 0;
+    while (total < data.size()) {
+        ssize_t br = read(src_fd, data.data() + total, data.size() - total);
+        if (br == -1) {
+            if (errno == EINTR) continue;
+            close(src_fd);
+            return std::unexpected(std::system_error(errno, std::system_category(), "error lectura origen"));
+        }
+        if (br == 0) break; // el archivo encogió mientras lo leíamos
+        total += br;
+    }
+    close(src_fd);
+    data.resize(total);
+
+    if (pack.current_segment_size > 0 &&
+        pack.current_segment_size + data.size() > PACK_SEGMENT_MAX_SIZE) {
+        pack.current_segment++;
+        pack.current_segment_size = 0;
+    }
+
+    std::string seg_path = get_pack_segment_path(pack.dir, pack.current_segment);
+    int seg_fd = open(seg_path.c_str(), O_WRONLY | O_CREAT, 0644);
+    if (seg_fd == -1) {
+        return std::unexpected(std::system_error(errno, std::system_category(), "error abriendo segmento"));
+    }
+
+    // El offset sale del tamaño real del segmento y no de current_segment_size,
+    // que podría no coincidir si una escritura anterior quedó a medias.
+    struct stat seg_st;
+    if (fstat(seg_fd, &seg_st) == -1) {
+        int err = errno;
+        close(seg_fd);
+        return std::unexpected(std::system_error(err, std::system_category(), "error en fstat del segmento"));
+    }
+    uint64_t offset = seg_st.st_size;
+
+    PackEntry entry{path, pack.current_segment, offset, data.size()};
+
+    auto res = pwrite_all(seg_fd, data.data(), data.size(), offset);
+    if (res.has_value() && fsync(seg_fd) == -1) {
+        res = std::unexpected(std::system_error(errno, std::system_category(), "error en fsync del segmento"));
+    }
+    if (!res.has_value()) {
+        // Quitamos lo que llegara a escribirse para que el segmento no crezca con basura
+        if (ftruncate(seg_fd, offset) == -1) { /* el siguiente fstat lo tendrá en cuenta */ }
+        close(seg_fd);
+        pack.current_segment_size = offset;
+        return std::unexpected(res.error());
+    }
+    if (close(seg_fd) == -1) {
+        return std::unexpected(std::system_error(errno, std::system_category(), "error cerrando segmento"));
+    }
+    pack.current_segment_size = offset + data.size();
+
+    // El índice se actualiza después de que los datos estén en disco (fsync): si
+    // caemos entre medias solo perdemos unos bytes en el segmento, nunca apuntamos
+    // a datos inexistentes. Un registro escrito a medias se recorta para que el
+    // siguiente no quede detrás de él.
+    std::vector<char> rec = pack_encode_record(entry);
+    struct stat idx_st;
+    if (fstat(pack.index_fd, &idx_st) == -1) {
+        return std::unexpected(std::system_error(errno, std::system_category(), "error en fstat del índice"));
+    }
+    auto res_idx = write_all(pack.index_fd, rec.data(), rec.size());
+    if (!res_idx.has_value()) {
+        if (ftruncate(pack.index_fd, idx_st.st_size) == -1) { /* pack_open lo recortará */ }
+        return std::unexpected(res_idx.error());
+    }
+
+    pack_index_insert(pack, std::move(entry));
+    return {};
+}
+
+
+// Devuelve el contenido guardado para path con un único pread()
+inline std::expected<std::vector<char>, std::system_error>
+pack_read(const PackStore& pack, const std::string& path) {
+    const PackEntry* e = pack_find(pack, path);
+    if (!e) {
+        return std::unexpected(std::system_error(ENOENT, std::system_category(), "ruta no encontrada en el pack"));
+    }
+
+    std::string seg_path = get_pack_segment_path(pack.dir, e->segment);
+    int fd = open(seg_path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return std::unexpected(std::system_error(errno, std::system_category(), "error abriendo segmento"));
+    }
+
+    std::vector<char> data(e->size);
+    auto r = pread_all(fd, data.data(), data.size(), e->offset);
+    close(fd);
+    if (!r.has_value()) return std::unexpected(r.error());
+    return data;
+}
+
+
+// Merece la pena compactar cuando al menos la mitad del pack es espacio muerto
+inline bool pack_needs_compaction(const PackStore& pack) {
+    return pack.index_fd != -1 && pack.dead_bytes > 0 && pack.dead_bytes >= pack.live_bytes;
+}
+
+
+// Copia las entradas vigentes a segmentos nuevos, reescribe el índice ya ordenado
+// y borra los segmentos antiguos. El cambio de índice es atómico gracias a rename().
+inline std::expected<void, std::system_error> pack_compact(PackStore& pack) {
+    uint32_t first_old = pack.first_segment;
+    uint32_t last_old = pack.current_segment;
+    uint32_t segment = last_old + 1;
+    uint64_t segment_size = 0;
+
+    std::vector<PackEntry> new_index;
+    new_index.reserve(pack.index.size());
+
+    int out_fd = -1;
+    int in_fd = -1;
+    uint32_t in_segment = 0;
+    std::vector<char> buffer;
+
+    auto fail = [&](int err, const char* what) {
+        if (out_fd != -1) close(out_fd);
+        if (in_fd != -1) close(in_fd);
+        for (uint32_t s = last_old + 1; s <= segment; s++) {
+            unlink(get_pack_segment_path(pack.dir, s).c_str());
+        }
+        return std::unexpected(std::system_error(err, std::system_category(), what));
+    };
+
+    // Se copian en el orden en que están en disco y no en el del índice (por
+    // ruta): así cada segmento viejo se abre una sola vez y se lee seguido.
+    std::vector<const PackEntry*> order;
+    order.reserve(pack.index.size());
+    for (const PackEntry& e : pack.index) order.push_back(&e);
+    std::sort(order.begin(), order.end(), [](const PackEntry* a, const PackEntry* b) {
+        return a->segment != b->segment ? a->segment < b->segment : a->offset < b->offset;
+    });
+
+    for (const PackEntry* p : order) {
+        const PackEntry& e = *p;
+        if (in_fd == -1 || in_segment != e.segment) {
+            if (in_fd != -1) close(in_fd);
+            in_segment = e.segment;
+            in_fd = open(get_pack_segment_path(pack.dir, in_segment).c_str(), O_RDONLY);
+            if (in_fd == -1) return fail(errno, "error abriendo segmento antiguo");
+        }
+
+        if (out_fd != -1 && segment_size + e.size > PACK_SEGMENT_MAX_SIZE) {
+            // Cada segmento lleno tiene que estar en disco antes de que el índice lo use
+            if (fsync(out_fd) == -1) return fail(errno, "error en fsync del segmento");
+            close(out_fd);
+            out_fd = -1;
+            segment++;
+            segment_size = 0;
+        }
+        if (out_fd == -1) {
+            out_fd = open(get_pack_segment_path(pack.dir, segment).c_str(),
+                          O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (out_fd == -1) return fail(errno, "error creando segmento nuevo");
+        }
+
+        buffer.resize(e.size);
+        auto r = pread_all(in_fd, buffer.data(), buffer.size(), e.offset);
+        if (!r.has_value()) return fail(r.error().code().value(), "error leyendo segmento antiguo");
+        auto w = write_all(out_fd, buffer.data(), buffer.size());
+        if (!w.has_value()) return fail(w.error().code().value(), "error escribiendo segmento nuevo");
+
+        new_index.push_back(PackEntry{e.path, segment, segment_size, e.size});
+        segment_size += e.size;
+    }
+    if (in_fd != -1) close(in_fd);
+    in_fd = -1;
+    if (out_fd != -1 && fsync(out_fd) == -1) return fail(errno, "error en fsync del segmento");
+    if (out_fd != -1) close(out_fd);
+    out_fd = -1;
+    std::sort(new_index.begin(), new_index.end(),
+        [](const PackEntry& a, const PackEntry& b) { return a.path < b.path; });
+
+    // Índice nuevo: se escribe entero en un temporal y luego se renombra
+    std::string idx_path = get_pack_index_path(pack.dir);
+    std::string tmp_path = idx_path + ".tmp";
+    int tmp_fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (tmp_fd == -1) return fail(errno, "error creando índice temporal");
+
+    std::vector<char> idx_data;
+    for (const PackEntry& e : new_index) {
+        std::vector<char> rec = pack_encode_record(e);
+        idx_data.insert(idx_data.end(), rec.begin(), rec.end());
+    }
+    auto w = write_all(tmp_fd, idx_data.data(), idx_data.size());
+    if (!w.has_value() || fsync(tmp_fd) == -1) {
+        int err = w.has_value() ? errno : w.error().code().value();
+        close(tmp_fd);
+        unlink(tmp_path.c_str());
+        return fail(err, "error escribiendo índice temporal");
+    }
+    close(tmp_fd);
+
+    // Las entradas de los segmentos nuevos tienen que ser duraderas antes que el rename()
+    auto sync = pack_sync_dir(pack.dir);
+    if (!sync.has_value()) {
+        unlink(tmp_path.c_str());
+        return fail(sync.error().code().value(), "error en fsync del directorio del pack");
+    }
+
+    if (rename(tmp_path.c_str(), idx_path.c_str()) == -1) {
+        int err = errno;
+        unlink(tmp_path.c_str());
+        return fail(err, "error renombrando índice");
+    }
+
+    // El fd antiguo apunta al índice reemplazado: se cierra pase lo que pase. Si
+    // no podemos abrir el nuevo, el pack en memoria ya no corresponde al de disco
+    // y queda inutilizable hasta reiniciar (pack_open limpiará los segmentos viejos).
+    int fd = open(idx_path.c_str(), O_RDWR | O_APPEND);
+    int err = errno;
+    pack_close(pack);
+    if (fd == -1) {
+        return std::unexpected(std::system_error(err, std::system_category(), "error reabriendo índice"));
+    }
+    pack.index_fd = fd;
+
+    // Los segmentos viejos solo sobran cuando el rename() es duradero: si el fsync
+    // del directorio falla se quedan, y pack_open los borrará al volver a abrir.
+    sync = pack_sync_dir(pack.dir);
+    if (sync.has_value()) {
+        for (uint32_t s = first_old; s <= last_old; s++) {
+            unlink(get_pack_segment_path(pack.dir, s).c_str());
+        }
+        pack.first_segment = last_old + 1;
+    }
+
+    pack.index = std::move(new_index);
+    pack.current_segment = segment;
+    pack.current_segment_size = segment_size;
+    pack.dead_bytes = 0;
+    if (!sync.has_value()) return std::unexpected(sync.error());
+    return {};
+}
+
+#endif // PACK_HPP
@@ -0,0 +1,266 @@
+// checkpoint.hpp
+// Checkpoints de las copias reanudables, compartidos por copy (-c) y por el
+// servidor de backups.
+// Cada CHECKPOINT_INTERVAL bytes se sincroniza el destino y se añade a
+// DESTINO.checkpoint un registro con el final del tramo recién copiado y su hash.
+// Al reanudar se vuelven a leer los tramos del destino desde el principio y se
+// continúa al final del último que sigue cuadrando: si algo se estropeó en medio,
+// solo se copia otra vez desde ese tramo, y nunca se conserva un byte sin comprobar.
+//
+// Formato: una CheckpointHeader y detrás los CheckpointWindow, uno por tramo.
+// El checksum de cada registro se encadena con el del anterior (el primero con
+// el de la cabecera), así que un registro escrito a medias o de otra copia corta
+// la lista ahí.
+
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#include <string>
+#include <vector>
+#include <expected>
+#include <system_error>
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+constexpr uint64_t CHECKPOINT_INTERVAL = 64 * 1024 * 1024;  // 64MiB
+constexpr uint64_t CHECKPOINT_MAGIC = 0x32544e494f504b43;   // "CKPOINT2"
+constexpr size_t CHECKPOINT_VERIFY_BUFFER = 1024 * 1024;    // lecturas de 1MiB al verificar
+constexpr uint64_t HASH_SEED = 0xcbf29ce484222325;
+
+// Identifica la versión del origen: si cambia, lo copiado ya no vale
+struct SourceVersion {
+    uint64_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+};
+
+struct CheckpointHeader {
+    uint64_t magic;
+    SourceVersion src;
+    uint64_t checksum;        // hash de los campos anteriores
+};
+
+struct CheckpointWindow {
+    uint64_t end;             // el tramo va del final del anterior (o 0) hasta aquí
+    uint64_t hash;            // hash de los datos del tramo
+    uint64_t checksum;        // hash de end y hash encadenado con el registro anterior
+};
+
+// Hasta dónde llega la copia según el checkpoint, y cómo seguir añadiéndole tramos
+struct CheckpointState {
+    uint64_t offset = 0;      // bytes copiados y comprobados
+    uint64_t windows = 0;     // registros válidos en el archivo
+    uint64_t chain = 0;       // checksum del último registro (o de la cabecera)
+};
+
+
+inline SourceVersion source_version(const struct stat& st) {
+    return {static_cast<uint64_t>(st.st_size), st.st_mtim.tv_sec, st.st_mtim.tv_nsec};
+}
+
+
+inline SourceVersion source_version(const struct statx& st) {
+    return {st.stx_size, st.stx_mtime.tv_sec, st.stx_mtime.tv_nsec};
+}
+
+
+// Hash rápido de 8 en 8 bytes (estilo FNV) que se alimenta por trozos.
+// Los bytes que no completan una palabra se guardan para la llamada siguiente,
+// así que el resultado no depende de cómo se trocean los datos: la copia hashea
+// lo que devuelve cada read() y la verificación lee en bloques fijos.
+class StreamHash {
+public:
+    explicit StreamHash(uint64_t seed = HASH_SEED) : h_(seed) {}
+
+    void update(const char* data, size_t len) {
+        size_t i = 0;
+        if (pending_len_ > 0) {
+            i = std::min(8 - pending_len_, len);
+            memcpy(pending_ + pending_len_, data, i);
+            pending_len_ += i;
+            if (pending_len_ < 8) return;
+            mix(pending_);
+            pending_len_ = 0;
+        }
+        for (; i + 8 <= len; i += 8) {
+            mix(data + i);
+        }
+        pending_len_ = len - i;
+        memcpy(pending_, data + i, pending_len_);
+    }
+
+    uint64_t digest() const {
+        constexpr uint64_t prime = 0x100000001b3;
+        uint64_t h = h_;
+        for (size_t i = 0; i < pending_len_; i++) {
+            h = (h ^ static_cast<unsigned char>(pending_[i])) * prime;
+        }
+        return h;
+    }
+
+private:
+    void mix(const char* p) {
+        constexpr uint64_t prime = 0x100000001b3;
+        uint64_t word;
+        memcpy(&word, p, 8);
+        h_ = (h_ ^ word) * prime;
+        h_ ^= h_ >> 29;
+    }
+
+    uint64_t h_;
+    char pending_[8];
+    size_t pending_len_ = 0;
+};
+
+
+inline uint64_t hash_bytes(const char* data, size_t len, uint64_t seed = HASH_SEED) {
+    StreamHash h(seed);
+    h.update(data, len);
+    return h.digest();
+}
+
+
+inline std::string get_checkpoint_path(const std::string& dest_path) {
+    return dest_path + ".checkpoint";
+}
+
+
+// pread() que insiste hasta llenar el buffer o llegar a EOF
+inline ssize_t pread_full(int fd, char* buf, size_t len, off_t offset) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t r = pread(fd, buf + done, len - done, offset + done);
+        if (r == -1) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (r == 0) break;
+        done += r;
+    }
+    return static_cast<ssize_t>(done);
+}
+
+
+inline uint64_t checkpoint_header_checksum(const CheckpointHeader& hdr) {
+    return hash_bytes(reinterpret_cast<const char*>(&hdr), offsetof(CheckpointHeader, checksum));
+}
+
+
+inline uint64_t checkpoint_window_checksum(const CheckpointWindow& w, uint64_t chain) {
+    return hash_bytes(reinterpret_cast<const char*>(&w), offsetof(CheckpointWindow, checksum), chain);
+}
+
+
+// Devuelve desde dónde se puede continuar la copia a dest_fd: el final del último
+// tramo que, contando desde el principio, sigue cuadrando con su hash en el destino
+// (offset 0 si no hay checkpoint válido). Los registros de los tramos descartados
+// se quitan del checkpoint para que los nuevos vayan en su lugar.
+inline CheckpointState load_checkpoint(const std::string& dest_path, int dest_fd, const SourceVersion& src) {
+    CheckpointState state;
+    int fd = open(get_checkpoint_path(dest_path).c_str(), O_RDWR);
+    if (fd == -1) return state;
+
+    CheckpointHeader hdr;
+    if (pread_full(fd, reinterpret_cast<char*>(&hdr), sizeof(hdr), 0) != sizeof(hdr) ||
+        hdr.magic != CHECKPOINT_MAGIC || hdr.checksum != checkpoint_header_checksum(hdr) ||
+        hdr.src.size != src.size || hdr.src.mtime_sec != src.mtime_sec ||
+        hdr.src.mtime_nsec != src.mtime_nsec) {
+        close(fd);
+        return state;
+    }
+    state.chain = hdr.checksum;
+
+    struct stat dest_st;
+    if (fstat(dest_fd, &dest_st) == -1) {
+        close(fd);
+        return CheckpointState{};
+    }
+
+    std::vector<char> buffer(CHECKPOINT_VERIFY_BUFFER);
+    while (true) {
+        CheckpointWindow w;
+        off_t pos = sizeof(hdr) + state.windows * sizeof(w);
+        if (pread_full(fd, reinterpret_cast<char*>(&w), sizeof(w), pos) != sizeof(w)) break;
+        if (w.checksum != checkpoint_window_checksum(w, state.chain)) break;
+        if (w.end <= state.offset || w.end > src.size ||
+            w.end > static_cast<uint64_t>(dest_st.st_size)) break;
+
+        StreamHash h;
+        bool ok = true;
+        for (uint64_t p = state.offset; p < w.end; p += buffer.size()) {
+            size_t len = std::min<uint64_t>(buffer.size(), w.end - p);
+            if (pread_full(dest_fd, buffer.data(), len, p) != static_cast<ssize_t>(len)) {
+                ok = false;
+                break;
+            }
+            h.update(buffer.data(), len);
+        }
+        if (!ok || h.digest() != w.hash) break;
+
+        state.offset = w.end;
+        state.windows++;
+        state.chain = w.checksum;
+    }
+
+    if (ftruncate(fd, sizeof(hdr) + state.windows * sizeof(CheckpointWindow)) == -1) {
+        // si no se puede recortar, los registros sobrantes se sobrescriben al guardar
+    }
+    close(fd);
+    return state;
+}
+
+
+// Añade al checkpoint el tramo [state.offset, end) con su hash. El destino se
+// sincroniza antes para que el checkpoint nunca apunte a datos que aún no están
+// en disco. El primer tramo de una copia nueva escribe también la cabecera.
+inline std::expected<void, std::system_error>
+save_checkpoint(const std::string& dest_path, int dest_fd, const SourceVersion& src,
+                CheckpointState& state, uint64_t end, uint64_t hash) {
+    if (fdatasync(dest_fd) == -1) {
+        return std::unexpected(std::system_error(errno, std::system_category(), "error al sincronizar el archivo de destino"));
+    }
+
+    int flags = O_WRONLY | O_CREAT | (state.windows == 0 ? O_TRUNC : 0);
+    int fd = open(get_checkpoint_path(dest_path).c_str(), flags, 0644);
+    if (fd == -1) {
+        return std::unexpected(std::system_error(errno, std::system_category(), "error al abrir el checkpoint"));
+    }
+
+    auto write_at = [fd](const void* data, size_t len, off_t pos) {
+        ssize_t w = pwrite(fd, data, len, pos);
+        if (w == static_cast<ssize_t>(len)) return 0;
+        return w == -1 ? errno : EIO;
+    };
+
+    int err = 0;
+    uint64_t chain = state.chain;
+    if (state.windows == 0) {
+        CheckpointHeader hdr{CHECKPOINT_MAGIC, src, 0};
+        hdr.checksum = checkpoint_header_checksum(hdr);
+        err = write_at(&hdr, sizeof(hdr), 0);
+        chain = hdr.checksum;
+    }
+
+    CheckpointWindow w{end, hash, 0};
+    w.checksum = checkpoint_window_checksum(w, chain);
+    if (err == 0) {
+        err = write_at(&w, sizeof(w), sizeof(CheckpointHeader) + state.windows * sizeof(w));
+    }
+    close(fd);
+    if (err != 0) {
+        return std::unexpected(std::system_error(err, std::system_category(), "error al escribir el checkpoint"));
+    }
+
+    state.offset = end;
+    state.windows++;
+    state.chain = w.checksum;
+    return {};
+}
+
+#endif // CHECKPOINT_HPP
@@ -0,0 +1,59 @@
+#!/usr/bin/env bash
+
+# Compara los motores de copy (-e loop|range|mmap|auto) con archivos de varios tamaños.
+# Uso: ./bench_copy.sh [DIRECTORIO_TEMPORAL] [REPETICIONES]
+# Los archivos de prueba van en un subdirectorio nuevo de DIRECTORIO_TEMPORAL
+# (por defecto /tmp) que se borra al terminar; lo que ya hubiera no se toca.
+# Para que el resultado no dependa de la caché, ejecutar como root: se vacía
+# la page cache antes de cada copia si se puede.
+
+COPY=./copy
+BASE=${1:-/tmp}
+REPS=${2:-3}
+SIZES="4K 1M 64M 1G"
+ENGINES="loop range mmap auto"
+
+error_exit() {
+
+	echo "Error: $1" >&2
+	exit 1
+
+}
+
+drop_caches() {
+
+	sync
+	if [ -w /proc/sys/vm/drop_caches ]; then
+		echo 3 > /proc/sys/vm/drop_caches
+	fi
+}
+
+[ -x "$COPY" ] || error_exit "no se encuentra $COPY (g++ -std=c++23 -O2 -pthread copy.cc -o copy)"
+DIR=$(mktemp -d "$BASE/bench_copy.XXXXXX") || error_exit "no se puede crear un directorio en $BASE"
+trap 'rm -rf "$DIR"' EXIT
+
+printf "%-8s %-8s %12s %12s\n" "TAMAÑO" "MOTOR" "SEGUNDOS" "MB/s"
+
+for size in $SIZES; do
+	src="$DIR/src_$size"
+	head -c "$size" /dev/urandom > "$src" || error_exit "no se pudo crear $src"
+	bytes=$(stat -c %s "$src")
+
+	for engine in $ENGINES; do
+		best=""  # mejor tiempo en nanosegundos
+		for ((i = 0; i < REPS; i++)); do
+			rm -f "$DIR/dst"
+			drop_caches
+			start=$(date +%s%N)
+			"$COPY" -e "$engine" "$src" "$DIR/dst" > /dev/null 2>&1 || error_exit "falló la copia con $engine"
+			end=$(date +%s%N)
+			t=$((end - start))
+			if [ -z "$best" ] || [ "$t" -lt "$best" ]; then
+				best=$t
+			fi
+		done
+		cmp -s "$src" "$DIR/dst" || error_exit "la copia con $engine no coincide con el origen"
+		awk -v s="$size" -v e="$engine" -v ns="$best" -v b="$bytes" \
+			'BEGIN { printf "%-8s %-8s %12.4f %12.1f\n", s, e, ns / 1e9, b / (ns / 1e9) / 1e6 }'
+	done
+done
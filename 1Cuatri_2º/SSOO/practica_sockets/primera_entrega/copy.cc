@@ -3,101 +3,396 @@
 #include <vector>
 #include <cstring>
 #include <expected>
+#include <system_error>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#include <cstddef>
+#include <set>
+#include <utility>
 #include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/fs.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <dirent.h>
 #include <errno.h>
+#include <signal.h>
+#include <setjmp.h>
 
-bool is_directory(const std::string& path) {
-    struct stat st;
-    if (stat(path.c_str(), &st) == -1) {
-        return false; // Si no existe, no es directorio
+#include "../checkpoint.hpp"
+
+constexpr size_t BUFFER_SIZE = 64 * 1024; // 64 KiB, para el bucle read/write
+
+// Trozo que pedimos a cada copy_file_range() (16 MiB): pocas llamadas y progreso fluido
+constexpr size_t COPY_RANGE_CHUNK = 16 * 1024 * 1024;
+
+// Cada cuánto se refresca la línea de progreso
+constexpr auto PROGRESS_INTERVAL = std::chrono::milliseconds(500);
+
+// Bytes copiados entre todos los hilos, para el progreso en MB/s
+std::atomic<uint64_t> total_bytes_copied{0};
+
+// Motores de copia que se pueden elegir con -e
+enum class CopyEngine {
+    automatic,  // reflink, luego copy_file_range(), luego read/write
+    loop,       // read/write con buffer de 64 KiB
+    range,      // copy_file_range()
+    mmap        // write() directamente desde el origen proyectado en memoria
+};
+
+// Opciones de la línea de comandos
+struct CopyOptions {
+    bool recursive = false;            // -r: copiar directorios
+    bool resumable = false;            // -c: copias reanudables con checkpoints
+    CopyEngine engine = CopyEngine::automatic;  // -e MOTOR
+    unsigned jobs = 0;                 // -j N: hilos de copia (0 = nº de CPUs)
+    std::vector<std::string> sources;
+    std::string destination;
+};
+
+// Campos que pedimos a statx(): todo lo que usan check_args, print_file_info y la copia
+constexpr unsigned int STATX_FIELDS = STATX_TYPE | STATX_MODE | STATX_UID | STATX_GID |
+                                      STATX_INO | STATX_SIZE | STATX_ATIME | STATX_MTIME;
+
+// A partir de cuántas rutas merece la pena pedir los metadatos con varios hilos
+constexpr size_t PARALLEL_STATX_MIN = 32;
+
+// Foto de los metadatos de una ruta tomada con un único statx().
+// Se pasa a check_args, print_file_info y copy_file para no repetir stat() sobre la misma ruta.
+struct FileInfo {
+    int error = 0;            // errno de statx(), 0 si fue bien
+    struct statx stx{};
+};
+
+// Un archivo a copiar, ya con su ruta de destino resuelta
+struct CopyJob {
+    std::string src;
+    std::string dst;
+    FileInfo info;            // metadatos del origen (sin seguir enlaces)
+};
+
+// Directorio creado durante la copia: sus permisos y fechas se aplican al final,
+// cuando ya no vamos a escribir dentro de él
+struct DirJob {
+    std::string src;
+    std::string dst;
+    FileInfo info;
+};
+
+FileInfo get_file_info(const std::string& path, bool follow_links = true) {
+    FileInfo info;
+    int flags = follow_links ? 0 : AT_SYMLINK_NOFOLLOW;
+    if (statx(AT_FDCWD, path.c_str(), flags, STATX_FIELDS, &info.stx) == -1) {
+        info.error = errno;
     }
-    return S_ISDIR(st.st_mode);
+    return info;
+}
+
+// Pide los metadatos de muchas rutas a la vez. En NFS cada statx() es un viaje
+// de ida y vuelta al servidor: con varios hilos las esperas se solapan.
+std::vector<FileInfo> prefetch_file_info(const std::vector<std::string>& paths,
+                                         bool follow_links, unsigned num_threads) {
+    std::vector<FileInfo> infos(paths.size());
+    if (paths.size() < PARALLEL_STATX_MIN || num_threads <= 1) {
+        for (size_t i = 0; i < paths.size(); i++) infos[i] = get_file_info(paths[i], follow_links);
+        return infos;
+    }
+
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        for (size_t i = next++; i < paths.size(); i = next++) {
+            infos[i] = get_file_info(paths[i], follow_links);
+        }
+    };
+    if (num_threads > paths.size()) num_threads = static_cast<unsigned>(paths.size());
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < num_threads; t++) threads.emplace_back(worker);
+    for (std::thread& t : threads) t.join();
+    return infos;
+}
+
+bool is_directory(const FileInfo& info) {
+    return info.error == 0 && S_ISDIR(info.stx.stx_mode); // Si no existe, no es directorio
 }
 
 std::string get_filename(const std::string& path) {
-    size_t last_slash = path.find_last_of('/');
+    std::string p = path;
+    while (p.size() > 1 && p.back() == '/') p.pop_back(); // "dir/" -> "dir"
+    size_t last_slash = p.find_last_of('/');
     if (last_slash == std::string::npos) {
-        return path;
+        return p;
     }
-    return path.substr(last_slash + 1);
+    return p.substr(last_slash + 1);
+}
+
+std::string join_path(const std::string& dir, const std::string& name) {
+    if (!dir.empty() && dir.back() == '/') return dir + name;
+    return dir + "/" + name;
 }
 
-bool same_file(const std::string& path1, const std::string& path2) {
-    struct stat st1, st2;
-    if (stat(path1.c_str(), &st1) == -1 || stat(path2.c_str(), &st2) == -1) {
+bool same_file(const FileInfo& info1, const FileInfo& info2) {
+    if (info1.error != 0 || info2.error != 0) {
         return false; // Si alguno no existe, no son el mismo
     }
-    return (st1.st_dev == st2.st_dev) && (st1.st_ino == st2.st_ino);
+    return info1.stx.stx_dev_major == info2.stx.stx_dev_major &&
+           info1.stx.stx_dev_minor == info2.stx.stx_dev_minor &&
+           info1.stx.stx_ino == info2.stx.stx_ino;
 }
 
-bool check_args(int argc, char* argv[]) {
-    if (argc != 3) {
-        std::cerr << "copy: se deben indicar los archivos ORIGEN y DESTINO\n";
-        return false;
+// Identidad de un archivo (dispositivo, inodo), para guardarla en un std::set
+using FileId = std::pair<dev_t, uint64_t>;
+
+FileId file_id(const FileInfo& info) {
+    return {makedev(info.stx.stx_dev_major, info.stx.stx_dev_minor), info.stx.stx_ino};
+}
+
+// Dice si el directorio dir_info es la ruta path o uno de sus antepasados, como hace cp
+// antes de copiar un directorio dentro de sí mismo. Se sube con ".." comparando
+// dispositivo e inodo, así que da igual cómo esté escrita la ruta o si tiene enlaces.
+// Si path no existe se empieza por el directorio que la contendría.
+bool is_inside(const FileInfo& dir_info, std::string path) {
+    FileInfo info = get_file_info(path);
+    if (info.error != 0) {
+        while (path.size() > 1 && path.back() == '/') path.pop_back();
+        size_t last_slash = path.find_last_of('/');
+        if (last_slash == std::string::npos) path = ".";
+        else path = path.substr(0, last_slash == 0 ? 1 : last_slash);
+        info = get_file_info(path);
     }
 
-    const char* origen = argv[1];
-    const char* destino = argv[2];
+    while (info.error == 0) {
+        if (same_file(info, dir_info)) return true;
+        path = join_path(path, "..");
+        FileInfo parent = get_file_info(path);
+        if (same_file(parent, info)) break; // en la raíz ".." es ella misma
+        info = parent;
+    }
+    return false;
+}
 
-    // Comprobar que ambos archivos existen y no son el mismo
-    if (same_file(origen, destino)) {
-        std::cerr << "copy: el archivo ORIGEN y DESTINO no pueden ser el mismo\n";
-        return false;
+void print_usage() {
+    std::cerr << "uso: copy [-r] [-c] [-j HILOS] [-e auto|loop|range|mmap] ORIGEN... DESTINO\n";
+}
+
+std::expected<CopyOptions, std::string> parse_args(int argc, char* argv[]) {
+    CopyOptions opts;
+    opterr = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "rcj:e:")) != -1) {
+        switch (opt) {
+            case 'e': {
+                std::string e = optarg;
+                if (e == "auto") opts.engine = CopyEngine::automatic;
+                else if (e == "loop") opts.engine = CopyEngine::loop;
+                else if (e == "range") opts.engine = CopyEngine::range;
+                else if (e == "mmap") opts.engine = CopyEngine::mmap;
+                else return std::unexpected("motor desconocido: " + e);
+                break;
+            }
+            case 'c':
+                opts.resumable = true;
+                break;
+            case 'r':
+                opts.recursive = true;
+                break;
+            case 'j': {
+                char* end = nullptr;
+                long n = strtol(optarg, &end, 10);
+                if (end == optarg || *end != '\0' || n <= 0) {
+                    return std::unexpected("número de hilos inválido: " + std::string(optarg));
+                }
+                opts.jobs = static_cast<unsigned>(n);
+                break;
+            }
+            default:
+                return std::unexpected("opción desconocida");
+        }
+    }
+
+    if (argc - optind < 2) {
+        return std::unexpected("se deben indicar los archivos ORIGEN y DESTINO");
+    }
+    for (int i = optind; i < argc - 1; i++) opts.sources.push_back(argv[i]);
+    opts.destination = argv[argc - 1];
+
+    if (opts.jobs == 0) {
+        opts.jobs = std::thread::hardware_concurrency();
+        if (opts.jobs == 0) opts.jobs = 1;
     }
+    return opts;
+}
 
-    // Comprobar que el origen existe y es legible
-    if (access(origen, R_OK) == -1) {
-        std::cerr << "copy: error al acceder al archivo de origen: "
-                  << std::strerror(errno) << "\n";
+// src_info[i] son los metadatos de opts.sources[i]; dest_info los del destino.
+// Los permisos de lectura no se comprueban aquí: si falta alguno, open() dará el error.
+bool check_args(const CopyOptions& opts, const std::vector<FileInfo>& src_info,
+                const FileInfo& dest_info) {
+    // Con varios orígenes el destino tiene que ser un directorio, como en cp
+    if (opts.sources.size() > 1 && !is_directory(dest_info)) {
+        std::cerr << "copy: el DESTINO '" << opts.destination << "' no es un directorio\n";
         return false;
     }
 
+    for (size_t i = 0; i < opts.sources.size(); i++) {
+        const std::string& origen = opts.sources[i];
+
+        // Comprobar que el origen existe
+        if (src_info[i].error != 0) {
+            std::cerr << "copy: error al acceder a '" << origen << "': "
+                      << std::strerror(src_info[i].error) << "\n";
+            return false;
+        }
+
+        // Ruta final de la copia: si DESTINO es un directorio, el origen va dentro
+        std::string destino = opts.destination;
+        FileInfo final_info = dest_info;
+        if (is_directory(dest_info)) {
+            destino = join_path(destino, get_filename(origen));
+            final_info = get_file_info(destino);
+        }
+
+        // Comprobar que ambos archivos no son el mismo
+        if (same_file(src_info[i], dest_info) || same_file(src_info[i], final_info)) {
+            std::cerr << "copy: el archivo ORIGEN y DESTINO no pueden ser el mismo\n";
+            return false;
+        }
+
+        if (is_directory(src_info[i]) && !opts.recursive) {
+            std::cerr << "copy: se omite el directorio '" << origen << "' (falta -r)\n";
+            return false;
+        }
+
+        // Copiar un directorio dentro de sí mismo no terminaría nunca
+        if (is_directory(src_info[i]) && is_inside(src_info[i], destino)) {
+            std::cerr << "copy: no se puede copiar el directorio '" << origen
+                      << "' dentro de sí mismo, '" << destino << "'\n";
+            return false;
+        }
+    }
+
     return true;
 }
 
-std::expected <void, std::system_error> copy_file(
-    const std::string& src_path,
-    const std::string& dest_path
-) {
-    constexpr size_t BUFFER_SIZE = 64 * 1024; // 64 KiB
+// Copia permisos, propietario y fechas del origen al destino ya abierto.
+// El cambio de propietario solo funciona como root: si falla lo ignoramos, igual que cp.
+void preserve_metadata(int dest_fd, const struct statx& stx) {
+    if (fchown(dest_fd, stx.stx_uid, stx.stx_gid) == -1) {
+        // sin privilegios no se puede cambiar el propietario
+    }
+    fchmod(dest_fd, stx.stx_mode & 07777);
+    struct timespec times[2] = {{stx.stx_atime.tv_sec, stx.stx_atime.tv_nsec},
+                                {stx.stx_mtime.tv_sec, stx.stx_mtime.tv_nsec}};
+    futimens(dest_fd, times);
+}
+
+// Bucle clásico read/write, para cuando el kernel no puede copiar por nosotros
+std::expected<void, std::system_error> copy_loop(int src_fd, int dest_fd) {
     std::vector<char> buffer(BUFFER_SIZE);
 
-    int src_fd = open(src_path.c_str(), O_RDONLY);
-    if (src_fd == -1) {
-        return std::unexpected(std::system_error(
-            errno, std::system_category(), "error al abrir el archivo de origen"
-        ));
+    while (true) {
+        ssize_t bytes_read = read(src_fd, buffer.data(), buffer.size());
+        if (bytes_read == -1) {
+            if (errno == EINTR) continue;
+            return std::unexpected(std::system_error(
+                errno, std::system_category(), "error al leer el archivo de origen"
+            ));
+        }
+
+        if (bytes_read == 0) break; // EOF
+
+        ssize_t bytes_written = 0;
+        while (bytes_written < bytes_read) {
+            ssize_t result = write(dest_fd, buffer.data() + bytes_written,
+                                   bytes_read - bytes_written);
+            if (result == -1) {
+                if (errno == EINTR) continue;
+                return std::unexpected(std::system_error(
+                    errno, std::system_category(), "error al escribir en el archivo de destino"
+                ));
+            }
+            bytes_written += result;
+        }
+        total_bytes_copied += bytes_read;
     }
+    return {};
+}
 
-    // Abrir destino: crear si no existe, truncar si existe
-    int dest_fd = open(dest_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+// Copia con copy_file_range(): los datos no salen del kernel y en NFS/SMB
+// la copia se hace en el servidor. Devuelve false si no se puede usar en estos ficheros.
+std::expected<bool, std::system_error> copy_range(int src_fd, int dest_fd) {
+    bool first = true;
+    while (true) {
+        ssize_t n = copy_file_range(src_fd, nullptr, dest_fd, nullptr, COPY_RANGE_CHUNK, 0);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            if (first && (errno == EXDEV || errno == EINVAL || errno == ENOSYS ||
+                          errno == EOPNOTSUPP || errno == EBADF)) {
+                return false;
+            }
+            return std::unexpected(std::system_error(
+                errno, std::system_category(), "error en copy_file_range"
+            ));
+        }
+        if (n == 0) return true; // EOF
+        total_bytes_copied += n;
+        first = false;
+    }
+}
+
+// ============================
+// Copias reanudables (-c)
+// ============================
+// Cada CHECKPOINT_INTERVAL bytes sincronizamos el destino y añadimos a
+// DESTINO.checkpoint el hash del tramo copiado (ver checkpoint.hpp). Al volver
+// a lanzar la copia se comprueban esos tramos en el destino y se sigue desde el
+// último que cuadra.
+
+constexpr size_t RESUME_BUFFER_SIZE = 1024 * 1024;  // 1 MiB
+
+// Copia reanudable: pread/pwrite desde el último checkpoint válido.
+// No usa reflink ni copy_file_range() porque necesitamos ver los datos para el hash.
+std::expected<void, std::system_error> copy_resumable(
+    int src_fd, const struct statx& src_st, const std::string& dest_path
+) {
+    int dest_fd = open(dest_path.c_str(), O_RDWR | O_CREAT, 0666);
     if (dest_fd == -1) {
-        close(src_fd);
         return std::unexpected(std::system_error(
             errno, std::system_category(), "error al abrir el archivo de destino"
         ));
     }
 
+    const SourceVersion src_version = source_version(src_st);
+    CheckpointState checkpoint = load_checkpoint(dest_path, dest_fd, src_version);
+    uint64_t offset = checkpoint.offset;
+    if (offset > 0) {
+        std::cerr << "\ncopy: reanudando '" << dest_path << "' desde el byte " << offset << "\n";
+    }
+
+    std::vector<char> buffer(RESUME_BUFFER_SIZE);
+    StreamHash window_hash;
+
     while (true) {
-        ssize_t bytes_read = read(src_fd, buffer.data(), buffer.size());
+        ssize_t bytes_read = pread_full(src_fd, buffer.data(), buffer.size(), offset);
         if (bytes_read == -1) {
-            close(src_fd);
             close(dest_fd);
             return std::unexpected(std::system_error(
                 errno, std::system_category(), "error al leer el archivo de origen"
             ));
         }
-
         if (bytes_read == 0) break; // EOF
 
         ssize_t bytes_written = 0;
         while (bytes_written < bytes_read) {
-            ssize_t result = write(dest_fd, buffer.data() + bytes_written,
-                                   bytes_read - bytes_written);
+            ssize_t result = pwrite(dest_fd, buffer.data() + bytes_written,
+                                    bytes_read - bytes_written, offset + bytes_written);
             if (result == -1) {
-                close(src_fd);
+                if (errno == EINTR) continue;
                 close(dest_fd);
                 return std::unexpected(std::system_error(
                     errno, std::system_category(), "error al escribir en el archivo de destino"
@@ -105,65 +400,464 @@ std::expected <void, std::system_error> copy_file(
             }
             bytes_written += result;
         }
+
+        window_hash.update(buffer.data(), bytes_read);
+        offset += bytes_read;
+        total_bytes_copied += bytes_read;
+
+        if (offset - checkpoint.offset >= CHECKPOINT_INTERVAL) {
+            auto res = save_checkpoint(dest_path, dest_fd, src_version, checkpoint,
+                                       offset, window_hash.digest());
+            if (!res.has_value()) {
+                close(dest_fd);
+                return res;
+            }
+            window_hash = StreamHash();
+        }
+    }
+
+    // El destino podía ser más largo (copia anterior de otro archivo)
+    if (ftruncate(dest_fd, offset) == -1) {
+        close(dest_fd);
+        return std::unexpected(std::system_error(
+            errno, std::system_category(), "error al ajustar el tamaño del destino"
+        ));
+    }
+
+    preserve_metadata(dest_fd, src_st);
+    if (close(dest_fd) == -1) {
+        return std::unexpected(std::system_error(
+            errno, std::system_category(), "error al cerrar el archivo de destino"
+        ));
+    }
+
+    // Copia terminada: el checkpoint sobra
+    unlink(get_checkpoint_path(dest_path).c_str());
+    return {};
+}
+
+// ============================
+// Motor mmap (-e mmap)
+// ============================
+// Proyecta el origen en ventanas grandes y hace write() directamente desde la
+// proyección, sin pasar por un buffer intermedio. Si otro proceso trunca el origen
+// mientras copiamos, tocar las páginas que ya no existen provoca SIGBUS (o EFAULT
+// dentro de write()): en ambos casos abandonamos la copia con un error en vez de morir.
+
+// Ventana de 64 MiB, múltiplo de 2 MiB para que el kernel pueda usar páginas enormes
+constexpr size_t MMAP_WINDOW = 64 * 1024 * 1024;
+
+// Punto de retorno del hilo que está copiando con mmap (cada hilo tiene el suyo)
+thread_local sigjmp_buf* sigbus_jump = nullptr;
+
+void sigbus_handler(int signum) {
+    if (sigbus_jump != nullptr) {
+        siglongjmp(*sigbus_jump, 1);
+    }
+    // SIGBUS que no es nuestro: comportamiento por defecto
+    signal(signum, SIG_DFL);
+    raise(signum);
+}
+
+void install_sigbus_handler() {
+    struct sigaction sa{};
+    sa.sa_handler = sigbus_handler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_NODEFER;
+    sigaction(SIGBUS, &sa, nullptr);
+}
+
+// Escribe len bytes de la proyección en dest_fd. Devuelve 0, el errno de write()
+// o EFAULT si el origen se truncó (SIGBUS al leer la proyección).
+int write_from_mapping(int dest_fd, const char* data, size_t len) {
+    sigjmp_buf env;
+    if (sigsetjmp(env, 1) != 0) {
+        sigbus_jump = nullptr;
+        return EFAULT;
+    }
+    sigbus_jump = &env;
+
+    size_t written = 0;
+    int err = 0;
+    while (written < len) {
+        ssize_t result = write(dest_fd, data + written, len - written);
+        if (result == -1) {
+            if (errno == EINTR) continue;
+            err = errno;
+            break;
+        }
+        written += result;
+        total_bytes_copied += result;
+    }
+
+    sigbus_jump = nullptr;
+    return err;
+}
+
+// Devuelve false si el origen no se puede proyectar (p.ej. /proc, pipes).
+// Los archivos de /proc y /sys dicen tener tamaño 0 aunque al leerlos den datos,
+// así que con tamaño 0 o si no es un archivo regular también se devuelve false
+// y copy_file() usa el bucle read/write, que lee hasta EOF.
+std::expected<bool, std::system_error> copy_mmap(int src_fd, int dest_fd, const struct statx& st) {
+    const off_t size = st.stx_size;
+    if (!S_ISREG(st.stx_mode) || size == 0) {
+        return false;
+    }
+
+    for (off_t offset = 0; offset < size; offset += MMAP_WINDOW) {
+        size_t len = std::min<off_t>(MMAP_WINDOW, size - offset);
+
+        void* map = mmap(nullptr, len, PROT_READ, MAP_SHARED, src_fd, offset);
+        if (map == MAP_FAILED) {
+            if (offset == 0 && (errno == ENODEV || errno == EINVAL || errno == EACCES)) {
+                return false;
+            }
+            return std::unexpected(std::system_error(
+                errno, std::system_category(), "error en mmap del archivo de origen"
+            ));
+        }
+        // Solo son consejos: si el kernel no los admite seguimos igual
+        madvise(map, len, MADV_SEQUENTIAL);
+        madvise(map, len, MADV_HUGEPAGE);
+
+        int err = write_from_mapping(dest_fd, static_cast<const char*>(map), len);
+        munmap(map, len);
+
+        if (err == EFAULT) {
+            return std::unexpected(std::system_error(
+                EIO, std::system_category(), "el archivo de origen se truncó durante la copia"
+            ));
+        }
+        if (err != 0) {
+            return std::unexpected(std::system_error(
+                err, std::system_category(), "error al escribir en el archivo de destino"
+            ));
+        }
+    }
+    return true;
+}
+
+// Copia un archivo regular eligiendo el método más rápido disponible:
+// 1. reflink (FICLONE): en btrfs/XFS se comparten los bloques, no se copia nada
+// 2. copy_file_range(): copia dentro del kernel
+// 3. bucle read/write de 64 KiB
+// Con -e se fuerza un motor concreto (para comparar rendimiento con bench_copy.sh).
+// Con resumable se usa copy_resumable() para poder continuar si se interrumpe.
+// st son los metadatos del origen ya obtenidos con statx(): no se vuelven a pedir.
+std::expected<void, std::system_error> copy_file(
+    const std::string& src_path,
+    const std::string& dest_path,
+    const struct statx& st,
+    CopyEngine engine = CopyEngine::automatic,
+    bool resumable = false
+) {
+    int src_fd = open(src_path.c_str(), O_RDONLY);
+    if (src_fd == -1) {
+        return std::unexpected(std::system_error(
+            errno, std::system_category(), "error al abrir el archivo de origen"
+        ));
+    }
+
+    if (resumable) {
+        auto result = copy_resumable(src_fd, st, dest_path);
+        close(src_fd);
+        return result;
+    }
+
+    // Abrir destino: crear si no existe, truncar si existe
+    int dest_fd = open(dest_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (dest_fd == -1) {
+        close(src_fd);
+        return std::unexpected(std::system_error(
+            errno, std::system_category(), "error al abrir el archivo de destino"
+        ));
+    }
+
+    std::expected<void, std::system_error> result;
+    std::expected<bool, std::system_error> done = false;
+    if (engine == CopyEngine::automatic && ioctl(dest_fd, FICLONE, src_fd) == 0) {
+        total_bytes_copied += st.stx_size;
+        done = true;
+    } else if (engine == CopyEngine::automatic || engine == CopyEngine::range) {
+        done = copy_range(src_fd, dest_fd);
+    } else if (engine == CopyEngine::mmap) {
+        done = copy_mmap(src_fd, dest_fd, st);
+    }
+
+    if (!done.has_value()) {
+        result = std::unexpected(done.error());
+    } else if (!done.value()) {
+        result = copy_loop(src_fd, dest_fd);
+    }
+
+    if (result.has_value()) {
+        preserve_metadata(dest_fd, st);
     }
 
     close(src_fd);
-    close(dest_fd);
+    if (close(dest_fd) == -1 && result.has_value()) {
+        return std::unexpected(std::system_error(
+            errno, std::system_category(), "error al cerrar el archivo de destino"
+        ));
+    }
+    return result;
+}
+
+// Recrea un enlace simbólico en lugar de copiar el archivo al que apunta
+std::expected<void, std::system_error> copy_symlink(
+    const std::string& src_path,
+    const std::string& dest_path
+) {
+    std::vector<char> target(PATH_MAX);
+    ssize_t len = readlink(src_path.c_str(), target.data(), target.size() - 1);
+    if (len == -1) {
+        return std::unexpected(std::system_error(
+            errno, std::system_category(), "error al leer el enlace simbólico"
+        ));
+    }
+    target[len] = '\0';
+    unlink(dest_path.c_str());
+    if (symlink(target.data(), dest_path.c_str()) == -1) {
+        return std::unexpected(std::system_error(
+            errno, std::system_category(), "error al crear el enlace simbólico"
+        ));
+    }
+    return {};
+}
+
+// Recorre un directorio de origen creando los directorios de destino y
+// apuntando en jobs todos los archivos que hay que copiar. En created se apuntan
+// los directorios de destino: si alguno aparece dentro del origen no se recorre.
+std::expected<void, std::system_error> collect_jobs(
+    const std::string& src_dir,
+    const std::string& dest_dir,
+    const FileInfo& dir_info,
+    std::vector<CopyJob>& jobs,
+    std::vector<DirJob>& dirs,
+    std::set<FileId>& created,
+    unsigned num_threads
+) {
+    if (mkdir(dest_dir.c_str(), 0700) == -1 && errno != EEXIST) {
+        return std::unexpected(std::system_error(
+            errno, std::system_category(), "error al crear el directorio '" + dest_dir + "'"
+        ));
+    }
+    FileInfo dest_info = get_file_info(dest_dir, false);
+    if (dest_info.error == 0) created.insert(file_id(dest_info));
+    dirs.push_back(DirJob{src_dir, dest_dir, dir_info});
+
+    DIR* dir = opendir(src_dir.c_str());
+    if (dir == nullptr) {
+        return std::unexpected(std::system_error(
+            errno, std::system_category(), "error al abrir el directorio '" + src_dir + "'"
+        ));
+    }
+
+    // Primero leemos todos los nombres y luego pedimos sus metadatos de golpe
+    std::vector<std::string> names;
+    std::vector<std::string> srcs;
+    while (struct dirent* entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name == "." || name == "..") continue;
+        srcs.push_back(join_path(src_dir, name));
+        names.push_back(std::move(name));
+    }
+    closedir(dir);
+
+    std::vector<FileInfo> infos = prefetch_file_info(srcs, false, num_threads);
+
+    for (size_t i = 0; i < srcs.size(); i++) {
+        const std::string& src = srcs[i];
+        std::string dst = join_path(dest_dir, names[i]);
+
+        if (infos[i].error != 0) {
+            std::cerr << "copy: error al acceder a '" << src << "': " << std::strerror(infos[i].error) << "\n";
+            continue;
+        }
+
+        mode_t mode = infos[i].stx.stx_mode;
+        if (S_ISDIR(mode) && created.count(file_id(infos[i])) != 0) {
+            std::cerr << "copy: se omite '" << src << "': es un directorio de la copia\n";
+            continue;
+        }
+        if (S_ISDIR(mode)) {
+            auto res = collect_jobs(src, dst, infos[i], jobs, dirs, created, num_threads);
+            if (!res.has_value()) {
+                return res;
+            }
+        } else if (S_ISREG(mode) || S_ISLNK(mode)) {
+            jobs.push_back(CopyJob{src, dst, infos[i]});
+        } else {
+            std::cerr << "copy: se omite '" << src << "': no es un archivo regular\n";
+        }
+    }
+
     return {};
 }
 
 //MODI: Antes de copiar, Informacion en pantalla del fichero a origen a copiar, Tamaño, tipo de archivo, y el nombre de archivo
 
-void print_file_info(const std::string& path) {
-    struct stat st;
-    if (stat(path.c_str(), &st) == -1) {
+void print_file_info(const std::string& path, const FileInfo& info) {
+    if (info.error != 0) {
         std::cerr << "copy: error al obtener información del archivo: "
-                  << std::strerror(errno) << "\n";
+                  << std::strerror(info.error) << "\n";
         return;
     }
+    mode_t mode = info.stx.stx_mode;
 
     std::cout << "=== Información del archivo ===\n";
     std::cout << "Nombre: " << get_filename(path) << "\n";
     std::cout << "Ruta completa: " << path << "\n";
-    std::cout << "Tamaño: " << st.st_size << " bytes\n";
+    std::cout << "Tamaño: " << info.stx.stx_size << " bytes\n";
 
     std::cout << "Tipo: ";
-    if (S_ISREG(st.st_mode)) std::cout << "Archivo regular\n";
-    else if (S_ISDIR(st.st_mode)) std::cout << "Directorio\n";
-    else if (S_ISLNK(st.st_mode)) std::cout << "Enlace simbólico\n";
-    else if (S_ISCHR(st.st_mode)) std::cout << "Dispositivo de caracteres\n";
-    else if (S_ISBLK(st.st_mode)) std::cout << "Dispositivo de bloques\n";
-    else if (S_ISFIFO(st.st_mode)) std::cout << "FIFO/PIPE\n";
-    else if (S_ISSOCK(st.st_mode)) std::cout << "Socket\n";
+    if (S_ISREG(mode)) std::cout << "Archivo regular\n";
+    else if (S_ISDIR(mode)) std::cout << "Directorio\n";
+    else if (S_ISLNK(mode)) std::cout << "Enlace simbólico\n";
+    else if (S_ISCHR(mode)) std::cout << "Dispositivo de caracteres\n";
+    else if (S_ISBLK(mode)) std::cout << "Dispositivo de bloques\n";
+    else if (S_ISFIFO(mode)) std::cout << "FIFO/PIPE\n";
+    else if (S_ISSOCK(mode)) std::cout << "Socket\n";
     else std::cout << "Tipo desconocido\n";
 
 }
 
+// Copia todos los trabajos con un pool de hilos. Cada hilo coge el siguiente
+// trabajo libre con un contador atómico, así no hace falta cola con mutex.
+// Devuelve el número de archivos que fallaron.
+size_t run_jobs(const std::vector<CopyJob>& jobs, const CopyOptions& opts) {
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> failures{0};
+    std::mutex err_mutex;
+
+    auto worker = [&]() {
+        while (true) {
+            size_t i = next++;
+            if (i >= jobs.size()) break;
+
+            bool is_link = S_ISLNK(jobs[i].info.stx.stx_mode);
+            auto result = is_link ? copy_symlink(jobs[i].src, jobs[i].dst)
+                                  : copy_file(jobs[i].src, jobs[i].dst, jobs[i].info.stx,
+                                              opts.engine, opts.resumable);
+            if (!result.has_value()) {
+                failures++;
+                std::lock_guard<std::mutex> lock(err_mutex);
+                std::cerr << "\ncopy: '" << jobs[i].src << "': " << result.error().what() << "\n";
+            }
+        }
+    };
+
+    unsigned num_threads = opts.jobs;
+    if (num_threads > jobs.size()) num_threads = static_cast<unsigned>(jobs.size());
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < num_threads; t++) threads.emplace_back(worker);
+    for (std::thread& t : threads) t.join();
+
+    return failures;
+}
+
+// Muestra por stderr el total copiado y la velocidad media en MB/s hasta que done sea true
+void report_progress(std::atomic<bool>& done, std::mutex& m, std::condition_variable& cv,
+                     std::chrono::steady_clock::time_point start) {
+    std::unique_lock<std::mutex> lock(m);
+    while (!done) {
+        cv.wait_for(lock, PROGRESS_INTERVAL);
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double mb = total_bytes_copied / 1e6;
+        std::cerr << "\rcopy: " << static_cast<uint64_t>(mb) << " MB copiados, "
+                  << static_cast<uint64_t>(secs > 0 ? mb / secs : 0) << " MB/s   " << std::flush;
+    }
+    std::cerr << "\n";
+}
+
 
 
 int main(int argc, char* argv[]) {
-    if (!check_args(argc, argv)) {
+    auto parsed = parse_args(argc, argv);
+    if (!parsed.has_value()) {
+        std::cerr << "copy: " << parsed.error() << "\n";
+        print_usage();
         return 1;
     }
-    
+    CopyOptions opts = parsed.value();
 
-    std::string origen = argv[1];
-    std::string destino = argv[2];
+    // Un solo statx() por ruta de la línea de comandos, todas a la vez
+    std::vector<std::string> paths = opts.sources;
+    paths.push_back(opts.destination);
+    std::vector<FileInfo> src_info = prefetch_file_info(paths, true, opts.jobs);
+    FileInfo dest_info = src_info.back();
+    src_info.pop_back();
 
-    print_file_info(origen);
+    if (!check_args(opts, src_info, dest_info)) {
+        return 1;
+    }
+
+    // Resolvemos todos los orígenes a trabajos de copia concretos
+    bool dest_is_dir = is_directory(dest_info);
+    std::vector<CopyJob> jobs;
+    std::vector<DirJob> dirs;
+    std::set<FileId> created;
+
+    for (size_t i = 0; i < opts.sources.size(); i++) {
+        const std::string& origen = opts.sources[i];
+        print_file_info(origen, src_info[i]);
+
+        // Si destino es un directorio, ajustar ruta
+        std::string destino = opts.destination;
+        if (dest_is_dir) {
+            destino = join_path(destino, get_filename(origen));
+        }
 
-    // Si destino es un directorio, ajustar ruta
-    if (is_directory(destino)) {
-        destino += "/" + get_filename(origen);
+        if (is_directory(src_info[i])) {
+            auto res = collect_jobs(origen, destino, src_info[i], jobs, dirs, created, opts.jobs);
+            if (!res.has_value()) {
+                std::cerr << "copy: " << res.error().what() << "\n";
+                return 1;
+            }
+        } else {
+            jobs.push_back(CopyJob{origen, destino, src_info[i]});
+        }
     }
 
-    auto result = copy_file(origen, destino);
-    if (!result.has_value()) {
-        std::cerr << "copy: " << result.error().what() << "\n";
-        return 1;
+    std::atomic<bool> done{false};
+    std::mutex progress_mutex;
+    std::condition_variable progress_cv;
+    auto start = std::chrono::steady_clock::now();
+    std::thread progress(report_progress, std::ref(done), std::ref(progress_mutex),
+                         std::ref(progress_cv), start);
+
+    if (opts.engine == CopyEngine::mmap) {
+        install_sigbus_handler();
+    }
+
+    size_t failures = run_jobs(jobs, opts);
+
+    {
+        std::lock_guard<std::mutex> lock(progress_mutex);
+        done = true;
     }
+    progress_cv.notify_one();
+    progress.join();
+
+    // Ahora que nada se escribe dentro, copiamos permisos y fechas de los directorios.
+    // Al revés para que las fechas de los padres no cambien al tocar los hijos.
+    for (auto it = dirs.rbegin(); it != dirs.rend(); ++it) {
+        int fd = open(it->dst.c_str(), O_RDONLY | O_DIRECTORY);
+        if (fd == -1) continue;
+        preserve_metadata(fd, it->info.stx);
+        close(fd);
+    }
+
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "copy: " << jobs.size() - failures << " de " << jobs.size() << " archivos, "
+              << total_bytes_copied / 1e6 << " MB en " << secs << " s";
+    if (secs > 0) std::cerr << " (" << total_bytes_copied / 1e6 / secs << " MB/s)";
+    std::cerr << "\n";
 
-    return 0;
+    return failures == 0 ? 0 : 1;
 }
 
-//g++ -std=c++23 copy.cc -o copy
\ No newline at end of file
+//g++ -std=c++23 -O2 -pthread copy.cc -o copy
+//./copy origen.txt destino.txt
+//./copy -r -j 8 test_dir origen.txt /tmp/copia
+//./copy -c testfile.dat /mnt/backup/   (si se corta, repetir el mismo comando continúa)
@@ -0,0 +1,108 @@
+// AUTOR:
+// FECHA:
+// EMAIL:
+// VERSION: 1.0
+// ASIGNATURA: Algoritmos y Estructuras de Datos
+// PRÁCTICA Nº: 2
+// COMENTARIOS: asignadores de memoria para vector_t.
+//              aligned_allocator_t (el de por defecto) reserva con new pero
+//              alineado a ALLOC_ALIGNMENT bytes, de modo que los buffers
+//              empiezan en una línea de caché y los núcleos de simd.hpp nunca
+//              cargan un vector partido entre dos líneas.
+//              arena_allocator_t saca la memoria de un std::pmr::memory_resource,
+//              normalmente un std::pmr::monotonic_buffer_resource: reservar es
+//              mover un puntero y liberar no hace nada; la memoria se devuelve
+//              de golpe al destruir (o release()) el recurso. Sirve para los
+//              vectores temporales de un bucle:
+//
+//                std::pmr::monotonic_buffer_resource arena;
+//                for (...) {
+//                  vector_t<double, arena_allocator_t<double>> tmp(n, &arena);
+//                  ...
+//                }
+//                arena.release();
+//
+//              El recurso debe vivir más que todos los vectores que lo usan.
+
+// pauta de estilo [92]: comentarios multilínea usando solo "//"
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <memory_resource>
+
+using namespace std;
+
+// pauta de estilo [5]: una línea de caché, y el ancho de un registro AVX-512
+const size_t ALLOC_ALIGNMENT = 64;
+
+
+
+template<class T>
+class aligned_allocator_t
+{
+public:
+  typedef T value_type;
+
+  aligned_allocator_t(void) noexcept {}
+  template<class U> aligned_allocator_t(const aligned_allocator_t<U>&) noexcept {}
+
+  T* allocate(const size_t n)
+  {
+    return static_cast<T*>(::operator new(n * sizeof(T), align_val_t(ALLOC_ALIGNMENT)));
+  }
+
+  void deallocate(T* p, const size_t) noexcept
+  {
+    ::operator delete(p, align_val_t(ALLOC_ALIGNMENT));
+  }
+};
+
+template<class T, class U>
+bool operator==(const aligned_allocator_t<T>&, const aligned_allocator_t<U>&) { return true; }
+
+template<class T, class U>
+bool operator!=(const aligned_allocator_t<T>&, const aligned_allocator_t<U>&) { return false; }
+
+
+
+template<class T>
+class arena_allocator_t
+{
+public:
+  typedef T value_type;
+
+  // sin recurso se usa el de por defecto de pmr (new/delete)
+  arena_allocator_t(void) noexcept : resource_(pmr::get_default_resource()) {}
+  arena_allocator_t(pmr::memory_resource* resource) noexcept : resource_(resource) {}
+  template<class U> arena_allocator_t(const arena_allocator_t<U>& a) noexcept
+    : resource_(a.resource()) {}
+
+  T* allocate(const size_t n)
+  {
+    return static_cast<T*>(resource_->allocate(n * sizeof(T), ALLOC_ALIGNMENT));
+  }
+
+  void deallocate(T* p, const size_t n) noexcept
+  {
+    resource_->deallocate(p, n * sizeof(T), ALLOC_ALIGNMENT);
+  }
+
+  pmr::memory_resource* resource(void) const { return resource_; }
+
+private:
+  pmr::memory_resource* resource_;
+};
+
+template<class T, class U>
+bool operator==(const arena_allocator_t<T>& a, const arena_allocator_t<U>& b)
+{
+  return a.resource() == b.resource();
+}
+
+template<class T, class U>
+bool operator!=(const arena_allocator_t<T>& a, const arena_allocator_t<U>& b)
+{
+  return !(a == b);
+}
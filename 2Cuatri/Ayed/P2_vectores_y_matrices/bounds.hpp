@@ -0,0 +1,56 @@
+// AUTOR:
+// FECHA:
+// EMAIL:
+// VERSION: 1.0
+// ASIGNATURA: Algoritmos y Estructuras de Datos
+// PRÁCTICA Nº: 2
+// COMENTARIOS: políticas de comprobación de índices para vector_t y matrix_t,
+//              elegidas en compilación con un parámetro de plantilla:
+//                vector_t<double>                                     comprueba
+//                vector_t<double, aligned_allocator_t<double>,
+//                         unchecked_bounds_t>                         no comprueba
+//                matrix_t<double, unchecked_bounds_t>                 no comprueba
+//              checked_bounds_t usa assert, así que con NDEBUG tampoco
+//              comprueba nada; unchecked_bounds_t no comprueba nunca.
+//              raw_span_t es un trozo contiguo de un vector o de una fila de
+//              una matriz (desde 0 y sin comprobar nada) para los bucles
+//              internos: los índices se validan una vez al pedir el trozo.
+
+// pauta de estilo [92]: comentarios multilínea usando solo "//"
+
+#pragma once
+
+#include <cassert>
+
+using namespace std;
+
+struct checked_bounds_t
+{
+  static constexpr void check(const bool in_bounds) { assert(in_bounds); }
+};
+
+struct unchecked_bounds_t
+{
+  static constexpr void check(const bool) {}
+};
+
+
+
+template<class T>
+class raw_span_t
+{
+public:
+  raw_span_t(T* data, const int size) : data_(data), size_(size) {}
+
+  T* data(void) const { return data_; }
+  int size(void) const { return size_; }
+
+  T& operator[](const int i) const { return data_[i]; }
+
+  T* begin(void) const { return data_; }
+  T* end(void) const { return data_ + size_; }
+
+private:
+  T* data_;
+  int size_;
+};
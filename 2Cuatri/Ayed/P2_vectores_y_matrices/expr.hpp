@@ -0,0 +1,354 @@
+// AUTOR:
+// FECHA:
+// EMAIL:
+// VERSION: 1.0
+// ASIGNATURA: Algoritmos y Estructuras de Datos
+// PRÁCTICA Nº: 2
+// COMENTARIOS: plantillas de expresión para operar con vector_t y matrix_t.
+//              Los operadores no calculan nada: devuelven un nodo que recuerda
+//              la operación, y el cálculo se hace elemento a elemento al
+//              asignar el resultado a un vector_t o matrix_t. Así y = A * x + b
+//              es un único bucle sin vectores intermedios.
+//              Los nodos guardan referencias a los vector_t/matrix_t que usan,
+//              así que una expresión no debe guardarse en una variable (auto)
+//              que viva más que sus operandos.
+
+// pauta de estilo [92]: comentarios multilínea usando solo "//"
+
+#pragma once
+
+#include <cassert>
+#include <type_traits>
+
+#include "simd.hpp"
+#include "allocator.hpp"
+#include "bounds.hpp"
+
+using namespace std;
+
+template<class T, class Alloc = aligned_allocator_t<T>, class Bounds = checked_bounds_t>
+class vector_t;
+template<class T, class Bounds = checked_bounds_t> class matrix_t;
+
+
+
+// Base de todas las expresiones vectoriales (vector_t incluido). E es el tipo
+// concreto, que debe tener value_type, get_size() y operator[] (desde 0).
+template<class E>
+class vector_expr_t
+{
+public:
+  const E& self(void) const { return static_cast<const E&>(*this); }
+
+  // ¿lee la expresión el objeto que está en p? (los nodos lo redefinen)
+  bool reads(const void* p) const { return static_cast<const void*>(&self()) == p; }
+
+  // ¿sale mal evaluarla elemento a elemento directamente sobre p? Solo pasa
+  // si algún elemento del resultado depende de otras posiciones de p.
+  bool needs_temp(const void*) const { return false; }
+};
+
+
+
+// Base de las expresiones matriciales (matrix_t incluido): value_type, get_m(),
+// get_n() y operator()(i, j) desde 1, como matrix_t. Todas las operaciones
+// matriciales son elemento a elemento, así que nunca hace falta temporal.
+template<class E>
+class matrix_expr_t
+{
+public:
+  const E& self(void) const { return static_cast<const E&>(*this); }
+
+  bool reads(const void* p) const { return static_cast<const void*>(&self()) == p; }
+};
+
+
+
+// Cómo guarda un nodo a sus operandos: los vector_t y matrix_t por referencia,
+// los demás nodos (temporales de la propia expresión) por valor.
+template<class E>
+struct expr_ref_t
+{
+  typedef const E type;
+};
+
+template<class T, class Alloc, class Bounds>
+struct expr_ref_t<vector_t<T, Alloc, Bounds>>
+{
+  typedef const vector_t<T, Alloc, Bounds>& type;
+};
+
+template<class T, class Bounds>
+struct expr_ref_t<matrix_t<T, Bounds>>
+{
+  typedef const matrix_t<T, Bounds>& type;
+};
+
+
+
+// Cómo guarda matrix_vector_t al vector x: un vector_t por referencia y
+// cualquier otra expresión evaluada una sola vez en un vector_t propio. Cada
+// fila del producto lee x entero, así que reevaluar A * (B * x) o A * (x + y)
+// en cada fila costaría O(n^3) en vez de O(n^2).
+template<class V>
+struct expr_operand_t
+{
+  typedef const vector_t<typename V::value_type> type;
+};
+
+template<class T, class Alloc, class Bounds>
+struct expr_operand_t<vector_t<T, Alloc, Bounds>>
+{
+  typedef const vector_t<T, Alloc, Bounds>& type;
+};
+
+
+
+// ¿es E un vector_t o un matrix_t (con cualquier asignador y política)?
+template<class E>
+struct is_vector_t : false_type {};
+
+template<class T, class Alloc, class Bounds>
+struct is_vector_t<vector_t<T, Alloc, Bounds>> : true_type {};
+
+template<class E>
+struct is_matrix_t : false_type {};
+
+template<class T, class Bounds>
+struct is_matrix_t<matrix_t<T, Bounds>> : true_type {};
+
+
+
+struct expr_add_t
+{
+  template<class A, class B>
+  static auto apply(const A& a, const B& b) { return a + b; }
+};
+
+struct expr_sub_t
+{
+  template<class A, class B>
+  static auto apply(const A& a, const B& b) { return a - b; }
+};
+
+
+
+// l[i] op r[i]
+template<class L, class R, class Op>
+class vector_binary_t : public vector_expr_t<vector_binary_t<L, R, Op>>
+{
+public:
+  typedef typename L::value_type value_type;
+
+  vector_binary_t(const L& l, const R& r) : l_(l), r_(r)
+  {
+    assert(l.get_size() == r.get_size());
+  }
+
+  int get_size(void) const { return l_.get_size(); }
+  value_type operator[](const int i) const { return Op::apply(l_[i], r_[i]); }
+
+  bool reads(const void* p) const { return l_.reads(p) || r_.reads(p); }
+  bool needs_temp(const void* p) const { return l_.needs_temp(p) || r_.needs_temp(p); }
+
+private:
+  typename expr_ref_t<L>::type l_;
+  typename expr_ref_t<R>::type r_;
+};
+
+
+
+// s * e[i]
+template<class E>
+class vector_scale_t : public vector_expr_t<vector_scale_t<E>>
+{
+public:
+  typedef typename E::value_type value_type;
+
+  vector_scale_t(const value_type& s, const E& e) : s_(s), e_(e) {}
+
+  int get_size(void) const { return e_.get_size(); }
+  value_type operator[](const int i) const { return s_ * e_[i]; }
+
+  bool reads(const void* p) const { return e_.reads(p); }
+  bool needs_temp(const void* p) const { return e_.needs_temp(p); }
+
+private:
+  value_type s_;
+  typename expr_ref_t<E>::type e_;
+};
+
+
+
+// (A * x)[i] = fila i de A por x. x siempre acaba en un vector_t (ver
+// expr_operand_t), así que si A es un matrix_t de float o double la fila es
+// contigua y se usa el producto escalar de simd.hpp.
+template<class M, class V>
+class matrix_vector_t : public vector_expr_t<matrix_vector_t<M, V>>
+{
+public:
+  typedef typename M::value_type value_type;
+
+  matrix_vector_t(const M& m, const V& v) : m_(m), v_(v)
+  {
+    assert(m.get_n() == v.get_size());
+  }
+
+  int get_size(void) const { return m_.get_m(); }
+
+  value_type operator[](const int i) const
+  {
+    const int n = m_.get_n();
+    if constexpr (is_matrix_t<M>::value &&
+                  (is_same<value_type, double>::value || is_same<value_type, float>::value)) {
+      return simd_dot(m_.row(i + 1).data(), v_.data(), n);
+    } else {
+      value_type sum = value_type(0);
+      for (int j = 1; j <= n; ++j)
+        sum = sum + m_(i + 1, j) * v_[j - 1];
+      return sum;
+    }
+  }
+
+  bool reads(const void* p) const { return m_.reads(p) || v_.reads(p); }
+
+  // cada elemento lee todo x: si x es el destino, hay que usar un temporal
+  // (si x era una expresión ya está evaluada y no lee el destino)
+  bool needs_temp(const void* p) const { return v_.reads(p); }
+
+private:
+  typename expr_ref_t<M>::type m_;
+  typename expr_operand_t<V>::type v_;
+};
+
+
+
+// l(i, j) op r(i, j)
+template<class L, class R, class Op>
+class matrix_binary_t : public matrix_expr_t<matrix_binary_t<L, R, Op>>
+{
+public:
+  typedef typename L::value_type value_type;
+
+  matrix_binary_t(const L& l, const R& r) : l_(l), r_(r)
+  {
+    assert(l.get_m() == r.get_m() && l.get_n() == r.get_n());
+  }
+
+  int get_m(void) const { return l_.get_m(); }
+  int get_n(void) const { return l_.get_n(); }
+  value_type operator()(const int i, const int j) const { return Op::apply(l_(i, j), r_(i, j)); }
+
+  bool reads(const void* p) const { return l_.reads(p) || r_.reads(p); }
+
+private:
+  typename expr_ref_t<L>::type l_;
+  typename expr_ref_t<R>::type r_;
+};
+
+
+
+// s * e(i, j)
+template<class E>
+class matrix_scale_t : public matrix_expr_t<matrix_scale_t<E>>
+{
+public:
+  typedef typename E::value_type value_type;
+
+  matrix_scale_t(const value_type& s, const E& e) : s_(s), e_(e) {}
+
+  int get_m(void) const { return e_.get_m(); }
+  int get_n(void) const { return e_.get_n(); }
+  value_type operator()(const int i, const int j) const { return s_ * e_(i, j); }
+
+  bool reads(const void* p) const { return e_.reads(p); }
+
+private:
+  value_type s_;
+  typename expr_ref_t<E>::type e_;
+};
+
+
+
+// operadores vectoriales
+
+template<class L, class R>
+vector_binary_t<L, R, expr_add_t>
+operator+(const vector_expr_t<L>& l, const vector_expr_t<R>& r)
+{
+  return vector_binary_t<L, R, expr_add_t>(l.self(), r.self());
+}
+
+
+
+template<class L, class R>
+vector_binary_t<L, R, expr_sub_t>
+operator-(const vector_expr_t<L>& l, const vector_expr_t<R>& r)
+{
+  return vector_binary_t<L, R, expr_sub_t>(l.self(), r.self());
+}
+
+
+
+template<class E>
+vector_scale_t<E>
+operator*(const typename E::value_type& s, const vector_expr_t<E>& e)
+{
+  return vector_scale_t<E>(s, e.self());
+}
+
+
+
+template<class E>
+vector_scale_t<E>
+operator*(const vector_expr_t<E>& e, const typename E::value_type& s)
+{
+  return vector_scale_t<E>(s, e.self());
+}
+
+
+
+template<class M, class V>
+matrix_vector_t<M, V>
+operator*(const matrix_expr_t<M>& m, const vector_expr_t<V>& v)
+{
+  return matrix_vector_t<M, V>(m.self(), v.self());
+}
+
+
+
+// operadores matriciales (el producto de matrices sigue siendo multiply)
+
+template<class L, class R>
+matrix_binary_t<L, R, expr_add_t>
+operator+(const matrix_expr_t<L>& l, const matrix_expr_t<R>& r)
+{
+  return matrix_binary_t<L, R, expr_add_t>(l.self(), r.self());
+}
+
+
+
+template<class L, class R>
+matrix_binary_t<L, R, expr_sub_t>
+operator-(const matrix_expr_t<L>& l, const matrix_expr_t<R>& r)
+{
+  return matrix_binary_t<L, R, expr_sub_t>(l.self(), r.self());
+}
+
+
+
+template<class E>
+matrix_scale_t<E>
+operator*(const typename E::value_type& s, const matrix_expr_t<E>& e)
+{
+  return matrix_scale_t<E>(s, e.self());
+}
+
+
+
+template<class E>
+matrix_scale_t<E>
+operator*(const matrix_expr_t<E>& e, const typename E::value_type& s)
+{
+  return matrix_scale_t<E>(s, e.self());
+}
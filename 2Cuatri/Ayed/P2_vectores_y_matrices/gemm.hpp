@@ -0,0 +1,401 @@
+// AUTOR:
+// FECHA:
+// EMAIL:
+// VERSION: 1.0
+// ASIGNATURA: Algoritmos y Estructuras de Datos
+// PRÁCTICA Nº: 2
+// COMENTARIOS: producto de matrices por bloques (GEMM) para tipos aritméticos,
+//              secuencial o repartido entre varios hilos.
+//              C = A * B, con A de m x k, B de k x n y C de m x n, todas
+//              guardadas por filas; lda, ldb y ldc son los elementos que hay
+//              entre el comienzo de una fila y el de la siguiente, de modo que
+//              también valen submatrices de una matriz mayor.
+//
+//              Error: cada elemento se calcula con el producto escalar clásico,
+//              así que |C - fl(C)| <= gamma_k |A| |B| elemento a elemento, con
+//              gamma_k = k u / (1 - k u) y u = 2^-53 en double (Higham,
+//              "Accuracy and Stability of Numerical Algorithms", 3.5). Para la
+//              cota del producto de Strassen-Winograd ver strassen.hpp.
+
+// pauta de estilo [92]: comentarios multilínea usando solo "//"
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <type_traits>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#include "simd.hpp"
+#include "allocator.hpp"
+
+using namespace std;
+
+// pauta de estilo [5]: tamaños de bloque como constantes con nombre
+//
+// El micronúcleo calcula un trozo de GEMM_MR x GEMM_NR de C en registros; el
+// tamaño es el de los núcleos vectoriales de simd.hpp.
+// Un panel de B de GEMM_KC x GEMM_NR debe caber en L1, un bloque de A de
+// GEMM_MC x GEMM_KC en L2 y un bloque de B de GEMM_KC x GEMM_NC en L3.
+const int GEMM_MR = SIMD_KERNEL_MR;
+const int GEMM_NR = SIMD_KERNEL_NR;
+const int GEMM_KC = 256;
+const int GEMM_MC = 128;
+const int GEMM_NC = 2048;
+
+// En paralelo C se reparte en bloques de GEMM_MC x GEMM_PARALLEL_NC; son más
+// estrechos que GEMM_NC para que haya bloques de sobra entre los hilos.
+const int GEMM_PARALLEL_NC = 512;
+
+// Opciones del producto en paralelo.
+// Cada elemento de C lo calcula entero un único hilo y siempre en el mismo
+// orden, así que el resultado es idéntico bit a bit con cualquier número de
+// hilos. El modo determinista fija además qué hilo calcula cada bloque (sin
+// robo de trabajo), para que la ejecución y el reparto de páginas entre nodos
+// NUMA se repitan exactamente de una vez a otra.
+struct gemm_options_t
+{
+  int num_threads = 1;         // 0 = un hilo por CPU
+  bool deterministic = false;  // reparto estático de bloques
+  bool strassen = false;       // Strassen-Winograd en matrices grandes (strassen.hpp)
+};
+
+
+
+// Copia el bloque A[0:mc, 0:kc] (con lda elementos por fila) en paneles de
+// GEMM_MR filas, recorridos por columnas: el micronúcleo los lee en orden.
+// Los buffers de empaquetado se reservan alineados a una línea de caché
+// (allocator.hpp).
+// Las filas que faltan en el último panel se rellenan con ceros.
+template<class T>
+void
+gemm_pack_a(const int mc, const int kc, const T* a, const int lda, T* packed)
+{
+  for (int ir = 0; ir < mc; ir += GEMM_MR) {
+    const int mr = min(GEMM_MR, mc - ir);
+    for (int p = 0; p < kc; ++p) {
+      for (int i = 0; i < mr; ++i)
+        packed[i] = a[(ir + i) * lda + p];
+      for (int i = mr; i < GEMM_MR; ++i)
+        packed[i] = T(0);
+      packed += GEMM_MR;
+    }
+  }
+}
+
+
+
+// Copia el bloque B[0:kc, 0:nc] (con ldb elementos por fila) en paneles de
+// GEMM_NR columnas, de modo que cada columna de un panel queda contigua a la
+// siguiente en vez de separada por una fila entera de B.
+template<class T>
+void
+gemm_pack_b(const int kc, const int nc, const T* b, const int ldb, T* packed)
+{
+  for (int jr = 0; jr < nc; jr += GEMM_NR) {
+    const int nr = min(GEMM_NR, nc - jr);
+    for (int p = 0; p < kc; ++p) {
+      const T* row = b + p * ldb + jr;
+      for (int j = 0; j < nr; ++j)
+        packed[j] = row[j];
+      for (int j = nr; j < GEMM_NR; ++j)
+        packed[j] = T(0);
+      packed += GEMM_NR;
+    }
+  }
+}
+
+
+
+// Micronúcleo: C[0:mr, 0:nr] += Ap * Bp. Para float y double se usan los
+// núcleos vectoriales de simd.hpp; para el resto, los acumuladores van en un
+// array local de tamaño fijo para que el compilador los mantenga en registros.
+template<class T>
+inline void
+gemm_micro_kernel(const int kc, const T* a, const T* b,
+                  T* c, const int ldc, const int mr, const int nr)
+{
+  T acc[GEMM_MR][GEMM_NR] = {};
+  if constexpr (is_same<T, double>::value || is_same<T, float>::value) {
+    simd_gemm_kernel(kc, a, b, &acc[0][0]);
+  } else {
+    for (int p = 0; p < kc; ++p) {
+      for (int i = 0; i < GEMM_MR; ++i)
+        for (int j = 0; j < GEMM_NR; ++j)
+          acc[i][j] += a[i] * b[j];
+      a += GEMM_MR;
+      b += GEMM_NR;
+    }
+  }
+  for (int i = 0; i < mr; ++i)
+    for (int j = 0; j < nr; ++j)
+      c[i * ldc + j] += acc[i][j];
+}
+
+
+
+// Recorre los paneles empaquetados de un bloque mc x nc de C (con ldc
+// elementos por fila) llamando al micronúcleo para cada trozo de MR x NR.
+template<class T>
+inline void
+gemm_macro_kernel(const int mc, const int nc, const int kc,
+                  const T* packed_a, const T* packed_b, T* c, const int ldc)
+{
+  for (int jr = 0; jr < nc; jr += GEMM_NR) {
+    const int nr = min(GEMM_NR, nc - jr);
+    for (int ir = 0; ir < mc; ir += GEMM_MR) {
+      const int mr = min(GEMM_MR, mc - ir);
+      gemm_micro_kernel(kc, packed_a + ir * kc, packed_b + jr * kc,
+                        c + ir * ldc + jr, ldc, mr, nr);
+    }
+  }
+}
+
+
+
+// C = A * B por bloques. C no puede solaparse con A ni con B.
+template<class T>
+void
+gemm_blocked(const int m, const int n, const int k,
+             const T* a, const int lda, const T* b, const int ldb,
+             T* c, const int ldc)
+{
+  for (int i = 0; i < m; ++i)
+    fill(c + i * ldc, c + i * ldc + n, T(0));
+  if (m == 0 || n == 0 || k == 0)
+    return;
+
+  // buffers del tamaño del bloque más grande que se va a empaquetar, que
+  // con matrices pequeñas es mucho menor que GEMM_MC x GEMM_KC
+  const int kc_max = min(GEMM_KC, k);
+  vector<T, aligned_allocator_t<T>> packed_a((min(GEMM_MC, m) + GEMM_MR - 1) / GEMM_MR * GEMM_MR * kc_max);
+  vector<T, aligned_allocator_t<T>> packed_b(kc_max * ((min(GEMM_NC, n) + GEMM_NR - 1) / GEMM_NR) * GEMM_NR);
+
+  for (int jc = 0; jc < n; jc += GEMM_NC) {
+    const int nc = min(GEMM_NC, n - jc);
+    for (int pc = 0; pc < k; pc += GEMM_KC) {
+      const int kc = min(GEMM_KC, k - pc);
+      gemm_pack_b(kc, nc, b + pc * ldb + jc, ldb, packed_b.data());
+
+      for (int ic = 0; ic < m; ic += GEMM_MC) {
+        const int mc = min(GEMM_MC, m - ic);
+        gemm_pack_a(mc, kc, a + ic * lda + pc, lda, packed_a.data());
+        gemm_macro_kernel(mc, nc, kc, packed_a.data(), packed_b.data(),
+                          c + ic * ldc + jc, ldc);
+      }
+    }
+  }
+}
+
+
+
+// Bloque de C que calcula un hilo: filas [ic, ic + GEMM_MC) y columnas
+// [jc, jc + GEMM_PARALLEL_NC), recortadas al tamaño de C.
+struct gemm_tile_t
+{
+  int ic, jc;
+};
+
+
+
+// Cola de bloques de un hilo. El dueño los saca por delante y los demás, al
+// quedarse sin trabajo, los roban por detrás; así el dueño sigue con bloques
+// vecinos (que comparten paneles de A y B) y el ladrón se lleva los lejanos.
+class gemm_tile_queue_t
+{
+public:
+  void push(const gemm_tile_t& tile)
+  {
+    lock_guard<mutex> lock(mutex_);
+    tiles_.push_back(tile);
+  }
+
+  bool pop(gemm_tile_t& tile)
+  {
+    lock_guard<mutex> lock(mutex_);
+    if (tiles_.empty())
+      return false;
+    tile = tiles_.front();
+    tiles_.pop_front();
+    return true;
+  }
+
+  bool steal(gemm_tile_t& tile)
+  {
+    lock_guard<mutex> lock(mutex_);
+    if (tiles_.empty())
+      return false;
+    tile = tiles_.back();
+    tiles_.pop_back();
+    return true;
+  }
+
+private:
+  mutex mutex_;
+  deque<gemm_tile_t> tiles_;
+};
+
+
+
+// Hilos de gemm_parallel. Se crean la primera vez que hacen falta y quedan
+// dormidos entre un producto y el siguiente, así que quien llama muchas veces
+// (multiply_out_of_core, una vez por bloque) solo paga despertarlos. Los hilos
+// se numeran desde 1; el 0 es el que llama, que también trabaja.
+class gemm_thread_pool_t
+{
+public:
+  static gemm_thread_pool_t& instance(void)
+  {
+    static gemm_thread_pool_t pool;
+    return pool;
+  }
+
+  // Ejecuta job(id) para id = 0 .. num_threads - 1 (el 0 en el hilo que
+  // llama) y vuelve cuando han terminado todos. Los productos de hilos
+  // distintos se hacen de uno en uno.
+  void run(const int num_threads, const function<void(int)>& job)
+  {
+    lock_guard<mutex> run_lock(run_mutex_);
+    {
+      lock_guard<mutex> lock(mutex_);
+      while (int(threads_.size()) < num_threads - 1)
+        threads_.emplace_back(&gemm_thread_pool_t::loop, this,
+                              int(threads_.size()) + 1, generation_);
+      job_ = &job;
+      active_ = num_threads - 1;
+      pending_ = num_threads - 1;
+      ++generation_;
+    }
+    wake_.notify_all();
+
+    job(0);
+
+    unique_lock<mutex> lock(mutex_);
+    done_.wait(lock, [this] { return pending_ == 0; });
+    job_ = NULL;
+  }
+
+  ~gemm_thread_pool_t(void)
+  {
+    {
+      lock_guard<mutex> lock(mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    for (thread& t : threads_)
+      t.join();
+  }
+
+private:
+  gemm_thread_pool_t(void) {}
+
+  // Cada nuevo producto cambia generation_; los hilos con número mayor que
+  // active_ no hacen falta en él y vuelven a dormir.
+  void loop(const int id, unsigned long seen)
+  {
+    unique_lock<mutex> lock(mutex_);
+    while (true) {
+      wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+      if (stop_)
+        return;
+      seen = generation_;
+      if (id > active_)
+        continue;
+      const function<void(int)>* job = job_;
+      lock.unlock();
+      (*job)(id);
+      lock.lock();
+      if (--pending_ == 0)
+        done_.notify_one();
+    }
+  }
+
+  mutex run_mutex_;
+  mutex mutex_;
+  condition_variable wake_, done_;
+  vector<thread> threads_;
+  const function<void(int)>* job_ = NULL;
+  unsigned long generation_ = 0;
+  int active_ = 0;
+  int pending_ = 0;
+  bool stop_ = false;
+};
+
+
+
+// Calcula un bloque de C recorriendo k entero. El bloque se pone a cero aquí
+// y no antes, para que sus páginas las toque primero el hilo que lo calcula y
+// el sistema las coloque en su nodo NUMA.
+template<class T>
+void
+gemm_tile(const gemm_tile_t& tile, const int m, const int n, const int k,
+          const T* a, const int lda, const T* b, const int ldb,
+          T* c, const int ldc, T* packed_a, T* packed_b)
+{
+  const int mc = min(GEMM_MC, m - tile.ic);
+  const int nc = min(GEMM_PARALLEL_NC, n - tile.jc);
+  T* c_tile = c + tile.ic * ldc + tile.jc;
+
+  for (int i = 0; i < mc; ++i)
+    fill(c_tile + i * ldc, c_tile + i * ldc + nc, T(0));
+
+  for (int pc = 0; pc < k; pc += GEMM_KC) {
+    const int kc = min(GEMM_KC, k - pc);
+    gemm_pack_b(kc, nc, b + pc * ldb + tile.jc, ldb, packed_b);
+    gemm_pack_a(mc, kc, a + tile.ic * lda + pc, lda, packed_a);
+    gemm_macro_kernel(mc, nc, kc, packed_a, packed_b, c_tile, ldc);
+  }
+}
+
+
+
+// C = A * B repartiendo los bloques de C entre options.num_threads hilos del
+// gemm_thread_pool_t. Cada hilo empieza con un tramo contiguo de bloques y,
+// si acaba antes, roba de las colas de los demás (salvo en modo determinista).
+template<class T>
+void
+gemm_parallel(const int m, const int n, const int k,
+              const T* a, const int lda, const T* b, const int ldb,
+              T* c, const int ldc, const gemm_options_t& options)
+{
+  int num_threads = options.num_threads;
+  if (num_threads <= 0)
+    num_threads = max(1, int(thread::hardware_concurrency()));
+
+  vector<gemm_tile_t> tiles;
+  for (int ic = 0; ic < m; ic += GEMM_MC)
+    for (int jc = 0; jc < n; jc += GEMM_PARALLEL_NC)
+      tiles.push_back({ic, jc});
+
+  num_threads = min(num_threads, int(tiles.size()));
+  if (num_threads <= 1 || k == 0) {
+    gemm_blocked(m, n, k, a, lda, b, ldb, c, ldc);
+    return;
+  }
+
+  vector<gemm_tile_queue_t> queues(num_threads);
+  for (size_t t = 0; t < tiles.size(); ++t)
+    queues[t * num_threads / tiles.size()].push(tiles[t]);
+
+  auto worker = [&](const int id) {
+    // los buffers de empaquetado son de cada hilo y los reserva él mismo
+    const int kc_max = min(GEMM_KC, k);
+    vector<T, aligned_allocator_t<T>> packed_a((min(GEMM_MC, m) + GEMM_MR - 1) / GEMM_MR * GEMM_MR * kc_max);
+    vector<T, aligned_allocator_t<T>> packed_b(kc_max * ((min(GEMM_PARALLEL_NC, n) + GEMM_NR - 1) / GEMM_NR) * GEMM_NR);
+    gemm_tile_t tile;
+    while (true) {
+      bool found = queues[id].pop(tile);
+      for (int v = 1; !found && !options.deterministic && v < num_threads; ++v)
+        found = queues[(id + v) % num_threads].steal(tile);
+      if (!found)
+        break;
+      gemm_tile(tile, m, n, k, a, lda, b, ldb, c, ldc, packed_a.data(), packed_b.data());
+    }
+  };
+
+  gemm_thread_pool_t::instance().run(num_threads, worker);
+}
@@ -0,0 +1,452 @@
+// AUTOR:
+// FECHA:
+// EMAIL:
+// VERSION: 1.0
+// ASIGNATURA: Algoritmos y Estructuras de Datos
+// PRÁCTICA Nº: 2
+// COMENTARIOS: matrices guardadas en un fichero binario (formato de
+//              matrix_io.hpp) y proyectadas en memoria con mmap, para datos
+//              que no caben en RAM. Los elementos no se leen al abrir: el
+//              sistema trae del disco cada página la primera vez que se toca y
+//              la puede descartar cuando le falta memoria (las modificaciones
+//              se escriben en el fichero).
+//
+//              Se indexa desde 1 como matrix_t y es una expresión matricial
+//              (expr.hpp): un matrix_t se puede cargar entero o por trozos
+//              desde una mapped_matrix_t, y al revés.
+//
+//              multiply_out_of_core calcula C = A * B con las tres matrices en
+//              disco recorriendo C por bloques de tile x tile y k por trozos de
+//              tile; mientras calcula un paso pide al sistema (madvise) los
+//              bloques de A y B del siguiente, de modo que la lectura del disco
+//              se solapa con el cálculo. La memoria necesaria es la de un
+//              bloque de C y la de los bloques en uso, no la de las matrices.
+
+// pauta de estilo [92]: comentarios multilínea usando solo "//"
+
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bounds.hpp"
+#include "expr.hpp"
+#include "gemm.hpp"
+#include "matrix_io.hpp"
+
+using namespace std;
+
+// pauta de estilo [5]: lado de los bloques del producto fuera de memoria.
+// Con double, un bloque de 2048 x 2048 son 32 MB; en RAM hay como mucho un
+// bloque de C y el producto parcial.
+const int OOC_TILE = 2048;
+
+
+
+template<class T, class Bounds = checked_bounds_t>
+class mapped_matrix_t : public matrix_expr_t<mapped_matrix_t<T, Bounds>>
+{
+public:
+  typedef T value_type;
+
+  mapped_matrix_t(void);
+  mapped_matrix_t(mapped_matrix_t<T, Bounds>&&) noexcept;
+  ~mapped_matrix_t();
+
+  mapped_matrix_t<T, Bounds>& operator=(mapped_matrix_t<T, Bounds>&&) noexcept;
+
+  // copia en el fichero una expresión de las mismas dimensiones
+  template<class E> mapped_matrix_t<T, Bounds>& operator=(const matrix_expr_t<E>&);
+
+  // la proyección es única: no se copia
+  mapped_matrix_t(const mapped_matrix_t<T, Bounds>&) = delete;
+  mapped_matrix_t<T, Bounds>& operator=(const mapped_matrix_t<T, Bounds>&) = delete;
+
+  // Abre un fichero existente (solo lectura salvo que writable) o crea uno
+  // nuevo de m x n a cero. Devuelven false si no se puede o si el fichero no
+  // es una matriz de T.
+  bool open(const char*, const bool = false);
+  bool create(const char*, const int, const int);
+  void close(void);
+  bool is_open(void) const;
+
+  // fuerza la escritura en disco de las modificaciones
+  bool flush(void);
+
+  // getters
+  int get_m(void) const;
+  int get_n(void) const;
+
+  // getters-setters (solo si se abrió con escritura)
+  T& at(const int, const int);
+  T& operator()(const int, const int);
+
+  // getters constantes
+  const T& at(const int, const int) const;
+  const T& operator()(const int, const int) const;
+
+  // acceso sin comprobaciones, como en matrix_t
+  raw_span_t<T> row(const int);
+  raw_span_t<const T> row(const int) const;
+
+  // avisa al sistema de que pronto se va a leer el bloque de filas
+  // [i, i + rows) y columnas [j, j + cols) (desde 1)
+  void will_need(const int, const int, const int, const int) const;
+
+private:
+  char* map_;     // proyección del fichero entero, cabecera incluida
+  size_t size_;
+  T* data_;       // elementos, por filas
+  int m_, n_;
+  bool writable_;
+
+  bool map_file(const int, const bool);
+};
+
+
+
+// en los nodos de una expresión se guarda por referencia, como matrix_t
+template<class T, class Bounds>
+struct expr_ref_t<mapped_matrix_t<T, Bounds>>
+{
+  typedef const mapped_matrix_t<T, Bounds>& type;
+};
+
+
+
+template<class T, class Bounds>
+mapped_matrix_t<T, Bounds>::mapped_matrix_t(void)
+  : map_(NULL), size_(0), data_(NULL), m_(0), n_(0), writable_(false)
+{}
+
+
+
+template<class T, class Bounds>
+mapped_matrix_t<T, Bounds>::mapped_matrix_t(mapped_matrix_t<T, Bounds>&& A) noexcept
+  : map_(A.map_), size_(A.size_), data_(A.data_), m_(A.m_), n_(A.n_),
+    writable_(A.writable_)
+{
+  A.map_ = NULL;
+  A.close();
+}
+
+
+
+template<class T, class Bounds>
+mapped_matrix_t<T, Bounds>::~mapped_matrix_t()
+{
+  close();
+}
+
+
+
+template<class T, class Bounds>
+mapped_matrix_t<T, Bounds>&
+mapped_matrix_t<T, Bounds>::operator=(mapped_matrix_t<T, Bounds>&& A) noexcept
+{
+  if (this != &A) {
+    close();
+    map_ = A.map_;
+    size_ = A.size_;
+    data_ = A.data_;
+    m_ = A.m_;
+    n_ = A.n_;
+    writable_ = A.writable_;
+    A.map_ = NULL;
+    A.close();
+  }
+  return *this;
+}
+
+
+
+// Como en static_matrix_t, los elementos se escriben según se calculan
+template<class T, class Bounds>
+template<class E>
+mapped_matrix_t<T, Bounds>&
+mapped_matrix_t<T, Bounds>::operator=(const matrix_expr_t<E>& e)
+{
+  const E& expr = e.self();
+  assert(expr.get_m() == m_ && expr.get_n() == n_);
+  for (int i = 1; i <= m_; ++i) {
+    const raw_span_t<T> row_i = row(i);
+    for (int j = 1; j <= n_; ++j)
+      row_i[j - 1] = expr(i, j);
+  }
+  return *this;
+}
+
+
+
+// Proyecta el fichero abierto fd entero y comprueba la cabecera
+template<class T, class Bounds>
+bool
+mapped_matrix_t<T, Bounds>::map_file(const int fd, const bool writable)
+{
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < off_t(IO_HEADER_SIZE))
+    return false;
+  const int prot = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+  void* p = mmap(NULL, st.st_size, prot, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED)
+    return false;
+
+  uint64_t m, n;
+  const T* data = io_check_header<T>(static_cast<const char*>(p), st.st_size, m, n);
+  if (data == NULL || m == 0 || n == 0 || m > uint64_t(INT32_MAX) || n > uint64_t(INT32_MAX)) {
+    munmap(p, st.st_size);
+    return false;
+  }
+  map_ = static_cast<char*>(p);
+  size_ = st.st_size;
+  data_ = const_cast<T*>(data);
+  m_ = m;
+  n_ = n;
+  writable_ = writable;
+  return true;
+}
+
+
+
+template<class T, class Bounds>
+bool
+mapped_matrix_t<T, Bounds>::open(const char* path, const bool writable)
+{
+  close();
+  const int fd = ::open(path, writable ? O_RDWR : O_RDONLY);
+  if (fd < 0)
+    return false;
+  const bool ok = map_file(fd, writable);
+  ::close(fd);
+  return ok;
+}
+
+
+
+template<class T, class Bounds>
+bool
+mapped_matrix_t<T, Bounds>::create(const char* path, const int m, const int n)
+{
+  assert(m > 0 && n > 0);
+  close();
+  const int fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    return false;
+
+  // el fichero se crea disperso: los ceros no ocupan disco hasta escribirlos
+  const matrix_file_header_t h = io_make_header<T>(m, n);
+  char header[IO_HEADER_SIZE] = {};
+  memcpy(header, &h, sizeof(h));
+  const off_t size = off_t(IO_HEADER_SIZE) + off_t(m) * n * sizeof(T);
+  const bool ok = pwrite(fd, header, IO_HEADER_SIZE, 0) == ssize_t(IO_HEADER_SIZE) &&
+                  ftruncate(fd, size) == 0 && map_file(fd, true);
+  ::close(fd);
+  return ok;
+}
+
+
+
+template<class T, class Bounds>
+void
+mapped_matrix_t<T, Bounds>::close(void)
+{
+  if (map_ != NULL)
+    munmap(map_, size_);
+  map_ = NULL;
+  size_ = 0;
+  data_ = NULL;
+  m_ = 0;
+  n_ = 0;
+  writable_ = false;
+}
+
+
+
+template<class T, class Bounds>
+inline bool
+mapped_matrix_t<T, Bounds>::is_open(void) const
+{
+  return map_ != NULL;
+}
+
+
+
+template<class T, class Bounds>
+bool
+mapped_matrix_t<T, Bounds>::flush(void)
+{
+  return map_ == NULL || !writable_ || msync(map_, size_, MS_SYNC) == 0;
+}
+
+
+
+template<class T, class Bounds>
+inline int
+mapped_matrix_t<T, Bounds>::get_m(void) const
+{
+  return m_;
+}
+
+
+
+template<class T, class Bounds>
+inline int
+mapped_matrix_t<T, Bounds>::get_n(void) const
+{
+  return n_;
+}
+
+
+
+template<class T, class Bounds>
+T&
+mapped_matrix_t<T, Bounds>::at(const int i, const int j)
+{
+  assert(writable_);
+  Bounds::check(i > 0 && i <= m_ && j > 0 && j <= n_);
+  return data_[size_t(i - 1) * n_ + (j - 1)];
+}
+
+
+
+template<class T, class Bounds>
+T&
+mapped_matrix_t<T, Bounds>::operator()(const int i, const int j)
+{
+  return at(i, j);
+}
+
+
+
+template<class T, class Bounds>
+const T&
+mapped_matrix_t<T, Bounds>::at(const int i, const int j) const
+{
+  Bounds::check(i > 0 && i <= m_ && j > 0 && j <= n_);
+  return data_[size_t(i - 1) * n_ + (j - 1)];
+}
+
+
+
+template<class T, class Bounds>
+const T&
+mapped_matrix_t<T, Bounds>::operator()(const int i, const int j) const
+{
+  return at(i, j);
+}
+
+
+
+template<class T, class Bounds>
+inline raw_span_t<T>
+mapped_matrix_t<T, Bounds>::row(const int i)
+{
+  assert(writable_);
+  Bounds::check(i > 0 && i <= m_);
+  return raw_span_t<T>(data_ + size_t(i - 1) * n_, n_);
+}
+
+
+
+template<class T, class Bounds>
+inline raw_span_t<const T>
+mapped_matrix_t<T, Bounds>::row(const int i) const
+{
+  Bounds::check(i > 0 && i <= m_);
+  return raw_span_t<const T>(data_ + size_t(i - 1) * n_, n_);
+}
+
+
+
+// madvise trabaja con páginas enteras: cada trozo de fila se amplía a las
+// páginas que lo contienen. Si las filas del bloque son casi enteras, se pide
+// todo el rango de una vez en lugar de fila a fila.
+template<class T, class Bounds>
+void
+mapped_matrix_t<T, Bounds>::will_need(const int i, const int j,
+                                      const int rows, const int cols) const
+{
+  Bounds::check(i > 0 && j > 0 && i + rows - 1 <= m_ && j + cols - 1 <= n_);
+  const uintptr_t page = sysconf(_SC_PAGESIZE);
+  auto advise = [&](const char* begin, const char* end) {
+    const uintptr_t b = reinterpret_cast<uintptr_t>(begin) & ~(page - 1);
+    const uintptr_t e = reinterpret_cast<uintptr_t>(end);
+    madvise(reinterpret_cast<void*>(b), e - b, MADV_WILLNEED);
+  };
+
+  const char* first = reinterpret_cast<const char*>(&at(i, j));
+  if (size_t(n_ - cols) * sizeof(T) < page) {
+    advise(first, first + (size_t(rows - 1) * n_ + cols) * sizeof(T));
+    return;
+  }
+  for (int r = 0; r < rows; ++r) {
+    const char* begin = first + size_t(r) * n_ * sizeof(T);
+    advise(begin, begin + size_t(cols) * sizeof(T));
+  }
+}
+
+
+
+// Un paso del producto fuera de memoria: bloque (ic, jc) de C y trozo pc de k
+struct ooc_step_t
+{
+  int ic, jc, pc;
+};
+
+
+
+// FASE III: producto matricial fuera de memoria, C = A * B con C abierta para
+// escritura y distinta de A y B. Cada paso lee los bloques directamente de la
+// proyección (el empaquetado de gemm.hpp ya los copia a memoria contigua) y
+// acumula el producto parcial en un bloque de C que está en RAM.
+template<class T, class Bounds>
+void
+multiply_out_of_core(const mapped_matrix_t<T, Bounds>& A, const mapped_matrix_t<T, Bounds>& B,
+                     mapped_matrix_t<T, Bounds>& C, const gemm_options_t& options = gemm_options_t(),
+                     const int tile = OOC_TILE)
+{
+  assert(A.get_n() == B.get_m() && C.get_m() == A.get_m() && C.get_n() == B.get_n());
+  assert(&C != &A && &C != &B && tile > 0);
+  const int m = A.get_m(), n = B.get_n(), k = A.get_n();
+
+  vector<ooc_step_t> steps;
+  for (int ic = 0; ic < m; ic += tile)
+    for (int jc = 0; jc < n; jc += tile)
+      for (int pc = 0; pc < k; pc += tile)
+        steps.push_back({ic, jc, pc});
+
+  const size_t tile_size = size_t(min(tile, m)) * min(tile, n);
+  vector<T, aligned_allocator_t<T>> c_tile(tile_size), partial(tile_size);
+
+  auto prefetch = [&](const ooc_step_t& s) {
+    const int mc = min(tile, m - s.ic), nc = min(tile, n - s.jc), kc = min(tile, k - s.pc);
+    A.will_need(s.ic + 1, s.pc + 1, mc, kc);
+    B.will_need(s.pc + 1, s.jc + 1, kc, nc);
+  };
+  prefetch(steps[0]);
+
+  for (size_t s = 0; s < steps.size(); ++s) {
+    if (s + 1 < steps.size())
+      prefetch(steps[s + 1]);
+
+    const ooc_step_t& st = steps[s];
+    const int mc = min(tile, m - st.ic), nc = min(tile, n - st.jc), kc = min(tile, k - st.pc);
+    T* product = st.pc == 0 ? c_tile.data() : partial.data();
+    gemm_parallel(mc, nc, kc, A.row(st.ic + 1).data() + st.pc, k,
+                  B.row(st.pc + 1).data() + st.jc, n, product, nc, options);
+    if (st.pc != 0)
+      for (size_t e = 0; e < size_t(mc) * nc; ++e)
+        c_tile[e] += partial[e];
+
+    if (st.pc + kc >= k)
+      for (int i = 0; i < mc; ++i)
+        memcpy(C.row(st.ic + i + 1).data() + st.jc, c_tile.data() + size_t(i) * nc, nc * sizeof(T));
+  }
+}
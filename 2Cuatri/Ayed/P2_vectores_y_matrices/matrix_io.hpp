@@ -0,0 +1,415 @@
+// AUTOR:
+// FECHA:
+// EMAIL:
+// VERSION: 1.0
+// ASIGNATURA: Algoritmos y Estructuras de Datos
+// PRÁCTICA Nº: 2
+// COMENTARIOS: lectura y escritura rápidas de ficheros de vector_t y matrix_t
+//              de tipos aritméticos (para el resto, read() y write()).
+//
+//              Texto: el mismo formato que read() ("m n" y los elementos por
+//              filas; "n" y los elementos en un vector). El fichero se
+//              proyecta en memoria con mmap y se convierte con from_chars, sin
+//              pasar por istream; al escribir se usa to_chars sobre un buffer
+//              que se vuelca a trozos grandes.
+//
+//              Binario: una cabecera de IO_HEADER_SIZE bytes (matrix_file_header_t)
+//              y los elementos por filas tal cual están en memoria, así que
+//              cargar es proyectar el fichero y copiar, sin convertir nada. Los
+//              datos empiezan en un múltiplo de 64 bytes, con lo que también se
+//              pueden usar directamente desde la proyección. El fichero usa el
+//              orden de bytes de la máquina.
+//
+//              Todas las funciones devuelven false si no se puede abrir,
+//              proyectar o escribir el fichero o si su contenido no es válido;
+//              en ese caso el vector o la matriz quedan sin cambios.
+
+// pauta de estilo [92]: comentarios multilínea usando solo "//"
+
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <charconv>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "vector_t.hpp"
+#include "matrix_t.hpp"
+
+using namespace std;
+
+// pauta de estilo [5]
+const size_t IO_HEADER_SIZE = 64;             // los datos empiezan aquí
+const size_t IO_WRITE_BUFFER = 1 << 20;       // bytes por escritura
+const uint32_t IO_FORMAT_VERSION = 1;
+const char IO_MAGIC[8] = {'A', 'Y', 'E', 'D', 'M', 'A', 'T', '\0'};
+
+
+
+// Fichero proyectado en memoria, solo lectura. Se cierra al destruirse.
+class mapped_file_t
+{
+public:
+  mapped_file_t(const char* path)
+    : data_(NULL), size_(0)
+  {
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0)
+      return;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+      void* p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p != MAP_FAILED) {
+        data_ = static_cast<const char*>(p);
+        size_ = st.st_size;
+        madvise(p, size_, MADV_SEQUENTIAL);
+      }
+    }
+    close(fd);
+  }
+
+  ~mapped_file_t()
+  {
+    if (data_ != NULL)
+      munmap(const_cast<char*>(data_), size_);
+  }
+
+  mapped_file_t(const mapped_file_t&) = delete;
+  mapped_file_t& operator=(const mapped_file_t&) = delete;
+
+  bool is_open(void) const { return data_ != NULL; }
+  const char* data(void) const { return data_; }
+  size_t size(void) const { return size_; }
+
+private:
+  const char* data_;
+  size_t size_;
+};
+
+
+
+// Números separados por blancos en [begin, end)
+class text_parser_t
+{
+public:
+  text_parser_t(const char* begin, const char* end) : p_(begin), end_(end) {}
+
+  template<class T>
+  bool next(T& value)
+  {
+    while (p_ != end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r'))
+      ++p_;
+    if (p_ != end_ && *p_ == '+')  // from_chars no admite el signo +
+      ++p_;
+    const from_chars_result r = from_chars(p_, end_, value);
+    if (r.ec != errc())
+      return false;
+    p_ = r.ptr;
+    return true;
+  }
+
+private:
+  const char* p_;
+  const char* end_;
+};
+
+
+
+// Salida por bloques: los números se escriben con to_chars en un buffer que
+// se vuelca al fichero cuando se llena, nunca por líneas.
+class text_writer_t
+{
+public:
+  text_writer_t(FILE* f) : f_(f), ok_(true) { buffer_.reserve(IO_WRITE_BUFFER); }
+
+  // cualquier elemento aritmético, también char y signed char, se escribe
+  // como número para que read_text lo pueda volver a leer
+  template<class T>
+  void put(const T value)
+  {
+    char s[64];
+    const to_chars_result r = to_chars(s, s + sizeof(s), value);
+    buffer_.insert(buffer_.end(), s, r.ptr);
+  }
+
+  // separadores (espacio, salto de línea) tal cual
+  void put_sep(const char c)
+  {
+    buffer_.push_back(c);
+    if (buffer_.size() >= IO_WRITE_BUFFER)
+      flush();
+  }
+
+  bool flush(void)
+  {
+    if (!buffer_.empty() && fwrite(buffer_.data(), 1, buffer_.size(), f_) != buffer_.size())
+      ok_ = false;
+    buffer_.clear();
+    return ok_;
+  }
+
+private:
+  FILE* f_;
+  bool ok_;
+  vector<char> buffer_;
+};
+
+
+
+// Cabecera de los ficheros binarios; ocupa IO_HEADER_SIZE bytes con el
+// relleno. Un vector se guarda como una matriz de 1 x n.
+struct matrix_file_header_t
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t elem_size;    // sizeof(T)
+  uint32_t elem_kind;    // 0 entero con signo, 1 entero sin signo, 2 real
+  uint32_t reserved;
+  uint64_t m, n;
+  uint64_t data_offset;  // IO_HEADER_SIZE
+};
+
+static_assert(sizeof(matrix_file_header_t) <= IO_HEADER_SIZE,
+              "matrix_file_header_t no cabe en IO_HEADER_SIZE");
+
+
+
+template<class T>
+uint32_t
+io_elem_kind(void)
+{
+  return is_floating_point<T>::value ? 2 : is_signed<T>::value ? 0 : 1;
+}
+
+
+
+template<class T>
+matrix_file_header_t
+io_make_header(const uint64_t m, const uint64_t n)
+{
+  matrix_file_header_t h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, IO_MAGIC, sizeof(h.magic));
+  h.version = IO_FORMAT_VERSION;
+  h.elem_size = sizeof(T);
+  h.elem_kind = io_elem_kind<T>();
+  h.m = m;
+  h.n = n;
+  h.data_offset = IO_HEADER_SIZE;
+  return h;
+}
+
+
+
+// Comprueba la cabecera de un fichero de size bytes proyectado en data para
+// elementos de tipo T y devuelve dónde empiezan los datos
+template<class T>
+const T*
+io_check_header(const char* data, const size_t size, uint64_t& m, uint64_t& n)
+{
+  if (data == NULL || size < IO_HEADER_SIZE)
+    return NULL;
+  matrix_file_header_t h;
+  memcpy(&h, data, sizeof(h));
+  if (memcmp(h.magic, IO_MAGIC, sizeof(h.magic)) != 0 || h.version != IO_FORMAT_VERSION ||
+      h.elem_size != sizeof(T) || h.elem_kind != io_elem_kind<T>() ||
+      h.data_offset % alignof(T) != 0 || h.data_offset > size ||
+      (h.n != 0 && h.m > (size - h.data_offset) / sizeof(T) / h.n))
+    return NULL;
+  m = h.m;
+  n = h.n;
+  return reinterpret_cast<const T*>(data + h.data_offset);
+}
+
+
+
+template<class T>
+bool
+io_write_binary(const char* path, const uint64_t m, const uint64_t n, const T* data)
+{
+  FILE* f = fopen(path, "wb");
+  if (f == NULL)
+    return false;
+  const matrix_file_header_t h = io_make_header<T>(m, n);
+  char header[IO_HEADER_SIZE] = {};
+  memcpy(header, &h, sizeof(h));
+  bool ok = fwrite(header, 1, IO_HEADER_SIZE, f) == IO_HEADER_SIZE &&
+            fwrite(data, sizeof(T), m * n, f) == m * n;
+  ok = fclose(f) == 0 && ok;
+  return ok;
+}
+
+
+
+// Cada elemento en texto ocupa al menos un carácter más un separador (el
+// último puede no llevarlo): dice si un fichero de size bytes puede tener
+// count elementos, para no reservar memoria por una cabecera falsa.
+inline bool
+io_text_fits(const uint64_t count, const size_t size)
+{
+  return count == 0 || 2 * count - 1 <= size;
+}
+
+
+
+// FASE IV: E/S rápida
+
+template<class T, class Alloc, class Bounds>
+bool
+read_text(const char* path, vector_t<T, Alloc, Bounds>& v)
+{
+  static_assert(is_arithmetic<T>::value, "read_text: solo tipos aritméticos");
+  mapped_file_t f(path);
+  if (!f.is_open())
+    return false;
+  text_parser_t parser(f.data(), f.data() + f.size());
+  int n;
+  if (!parser.next(n) || n < 0 || !io_text_fits(uint64_t(n), f.size()))
+    return false;
+  vector_t<T, Alloc, Bounds> tmp(n, v.get_allocator());
+  for (T& x : tmp.span())
+    if (!parser.next(x))
+      return false;
+  v = move(tmp);
+  return true;
+}
+
+
+
+template<class T, class Bounds>
+bool
+read_text(const char* path, matrix_t<T, Bounds>& A)
+{
+  static_assert(is_arithmetic<T>::value, "read_text: solo tipos aritméticos");
+  mapped_file_t f(path);
+  if (!f.is_open())
+    return false;
+  text_parser_t parser(f.data(), f.data() + f.size());
+  int m, n;
+  if (!parser.next(m) || !parser.next(n) || m <= 0 || n <= 0 ||
+      uint64_t(m) * n > uint64_t(INT32_MAX) || !io_text_fits(uint64_t(m) * n, f.size()))
+    return false;
+  matrix_t<T, Bounds> tmp(m, n);
+  for (T& x : tmp.span())
+    if (!parser.next(x))
+      return false;
+  A = move(tmp);
+  return true;
+}
+
+
+
+// Los reales se escriben con el mínimo de cifras que los recupera exactos
+template<class T, class Alloc, class Bounds>
+bool
+write_text(const char* path, const vector_t<T, Alloc, Bounds>& v)
+{
+  static_assert(is_arithmetic<T>::value, "write_text: solo tipos aritméticos");
+  FILE* f = fopen(path, "w");
+  if (f == NULL)
+    return false;
+  text_writer_t out(f);
+  out.put(v.get_size());
+  out.put_sep('\n');
+  for (const T& x : v.span()) {
+    out.put(x);
+    out.put_sep(' ');
+  }
+  out.put_sep('\n');
+  bool ok = out.flush();
+  ok = fclose(f) == 0 && ok;
+  return ok;
+}
+
+
+
+template<class T, class Bounds>
+bool
+write_text(const char* path, const matrix_t<T, Bounds>& A)
+{
+  static_assert(is_arithmetic<T>::value, "write_text: solo tipos aritméticos");
+  FILE* f = fopen(path, "w");
+  if (f == NULL)
+    return false;
+  text_writer_t out(f);
+  out.put(A.get_m());
+  out.put_sep(' ');
+  out.put(A.get_n());
+  out.put_sep('\n');
+  for (int i = 1; i <= A.get_m(); ++i) {
+    for (const T& x : A.row(i)) {
+      out.put(x);
+      out.put_sep(' ');
+    }
+    out.put_sep('\n');
+  }
+  bool ok = out.flush();
+  ok = fclose(f) == 0 && ok;
+  return ok;
+}
+
+
+
+template<class T, class Alloc, class Bounds>
+bool
+read_binary(const char* path, vector_t<T, Alloc, Bounds>& v)
+{
+  static_assert(is_arithmetic<T>::value, "read_binary: solo tipos aritméticos");
+  mapped_file_t f(path);
+  uint64_t m, n;
+  const T* data = io_check_header<T>(f.data(), f.size(), m, n);
+  if (data == NULL || m != 1 || n > uint64_t(INT32_MAX))
+    return false;
+  const int size = n;
+  vector_t<T, Alloc, Bounds> tmp(size, v.get_allocator());
+  if (n != 0)
+    memcpy(tmp.data(), data, n * sizeof(T));
+  v = move(tmp);
+  return true;
+}
+
+
+
+template<class T, class Bounds>
+bool
+read_binary(const char* path, matrix_t<T, Bounds>& A)
+{
+  static_assert(is_arithmetic<T>::value, "read_binary: solo tipos aritméticos");
+  mapped_file_t f(path);
+  uint64_t m, n;
+  const T* data = io_check_header<T>(f.data(), f.size(), m, n);
+  if (data == NULL || m == 0 || n == 0 || m * n > uint64_t(INT32_MAX))
+    return false;
+  const int rows = m, cols = n;
+  matrix_t<T, Bounds> tmp(rows, cols);
+  memcpy(tmp.span().data(), data, m * n * sizeof(T));
+  A = move(tmp);
+  return true;
+}
+
+
+
+template<class T, class Alloc, class Bounds>
+bool
+write_binary(const char* path, const vector_t<T, Alloc, Bounds>& v)
+{
+  static_assert(is_arithmetic<T>::value, "write_binary: solo tipos aritméticos");
+  return io_write_binary(path, 1, v.get_size(), v.data());
+}
+
+
+
+template<class T, class Bounds>
+bool
+write_binary(const char* path, const matrix_t<T, Bounds>& A)
+{
+  static_assert(is_arithmetic<T>::value, "write_binary: solo tipos aritméticos");
+  return io_write_binary(path, A.get_m(), A.get_n(), A.span().data());
+}
@@ -12,17 +12,33 @@
 
 #include <iostream>
 #include <cassert>
+#include <type_traits>
 
 #include "vector_t.hpp"
+#include "gemm.hpp"
+#include "strassen.hpp"
 
 using namespace std;
 
-template<class T>
-class matrix_t
+// Bounds decide si at() y () comprueban los índices (bounds.hpp); por
+// defecto, sí (valor por defecto en expr.hpp).
+template<class T, class Bounds>
+class matrix_t : public matrix_expr_t<matrix_t<T, Bounds>>
 {
 public:
+  typedef T value_type;
+
   matrix_t(const int = 0, const int = 0);
+  matrix_t(const matrix_t<T, Bounds>&);      // constructor de copia
+  matrix_t(matrix_t<T, Bounds>&&) noexcept;  // constructor de movimiento
   ~matrix_t();
+
+  matrix_t<T, Bounds>& operator=(const matrix_t<T, Bounds>&);
+  matrix_t<T, Bounds>& operator=(matrix_t<T, Bounds>&&) noexcept;
+
+  // construcción y asignación desde una expresión (expr.hpp)
+  template<class E> matrix_t(const matrix_expr_t<E>&);
+  template<class E> matrix_t<T, Bounds>& operator=(const matrix_expr_t<E>&);
   
   void resize(const int, const int);
   
@@ -37,9 +53,17 @@ public:
   // getters constantes
   const T& at(const int, const int) const;
   const T& operator()(const int, const int) const;
+
+  // acceso sin comprobaciones para los núcleos de cálculo: la fila i (desde
+  // 1, comprobada una vez) o todo el buffer, guardado por filas
+  raw_span_t<T> row(const int);
+  raw_span_t<const T> row(const int) const;
+  raw_span_t<T> span(void);
+  raw_span_t<const T> span(void) const;
   
   // operaciones y operadores
-  void multiply(const matrix_t<T>&, const matrix_t<T>&);
+  void multiply(const matrix_t<T, Bounds>&, const matrix_t<T, Bounds>&,
+                const gemm_options_t& = gemm_options_t());
   
   //MODI
   vector_t<T> main_diagonal(void);
@@ -58,8 +82,8 @@ private:
 
 
 
-template<class T>
-matrix_t<T>::matrix_t(const int m, const int n)
+template<class T, class Bounds>
+matrix_t<T, Bounds>::matrix_t(const int m, const int n)
 { 
   m_ = m;
   n_ = n;
@@ -68,15 +92,96 @@ matrix_t<T>::matrix_t(const int m, const int n)
 
 
 
-template<class T>
-matrix_t<T>::~matrix_t()
+template<class T, class Bounds>
+matrix_t<T, Bounds>::matrix_t(const matrix_t<T, Bounds>& A) : m_(A.m_), n_(A.n_), v_(A.v_)
 {}
 
 
 
-template<class T>
+// la nueva matriz se queda con el buffer de A, que queda como una de 0 x 0
+template<class T, class Bounds>
+matrix_t<T, Bounds>::matrix_t(matrix_t<T, Bounds>&& A) noexcept
+  : m_(A.m_), n_(A.n_), v_(move(A.v_))
+{
+  A.m_ = 0;
+  A.n_ = 0;
+}
+
+
+
+template<class T, class Bounds>
+matrix_t<T, Bounds>::~matrix_t()
+{}
+
+
+
+template<class T, class Bounds>
+matrix_t<T, Bounds>&
+matrix_t<T, Bounds>::operator=(const matrix_t<T, Bounds>& A)
+{
+  m_ = A.m_;
+  n_ = A.n_;
+  v_ = A.v_;
+  return *this;
+}
+
+
+
+template<class T, class Bounds>
+matrix_t<T, Bounds>&
+matrix_t<T, Bounds>::operator=(matrix_t<T, Bounds>&& A) noexcept
+{
+  if (this != &A) {
+    m_ = A.m_;
+    n_ = A.n_;
+    v_ = move(A.v_);
+    A.m_ = 0;
+    A.n_ = 0;
+  }
+  return *this;
+}
+
+
+
+template<class T, class Bounds>
+template<class E>
+matrix_t<T, Bounds>::matrix_t(const matrix_expr_t<E>& e)
+{
+  m_ = 0;
+  n_ = 0;
+  *this = e;
+}
+
+
+
+// Todas las operaciones matriciales son elemento a elemento, así que solo
+// hace falta un temporal si hay que cambiar el tamaño de una matriz que la
+// propia expresión está leyendo.
+template<class T, class Bounds>
+template<class E>
+matrix_t<T, Bounds>&
+matrix_t<T, Bounds>::operator=(const matrix_expr_t<E>& e)
+{
+  const E& expr = e.self();
+  if ((expr.get_m() != m_ || expr.get_n() != n_) && expr.reads(this)) {
+    matrix_t<T, Bounds> tmp(expr);
+    return *this = move(tmp);
+  }
+  if (expr.get_m() != m_ || expr.get_n() != n_)
+    resize(expr.get_m(), expr.get_n());
+  for (int i = 1; i <= m_; ++i) {
+    const raw_span_t<T> row_i = row(i);
+    for (int j = 1; j <= n_; ++j)
+      row_i[j - 1] = expr(i, j);
+  }
+  return *this;
+}
+
+
+
+template<class T, class Bounds>
 void
-matrix_t<T>::resize(const int m, const int n)
+matrix_t<T, Bounds>::resize(const int m, const int n)
 {
   assert(m > 0 && n > 0);
   m_ = m;
@@ -86,82 +191,120 @@ matrix_t<T>::resize(const int m, const int n)
 
 
 
-template<class T>
+template<class T, class Bounds>
 inline int
-matrix_t<T>::get_m() const
+matrix_t<T, Bounds>::get_m() const
 {
   return m_;
 }
 
 
 
-template<class T>
+template<class T, class Bounds>
 inline int
-matrix_t<T>::get_n() const
+matrix_t<T, Bounds>::get_n() const
 {
   return n_;
 }
 
 
 
-template<class T>
+template<class T, class Bounds>
 T&
-matrix_t<T>::at(const int i, const int j)
+matrix_t<T, Bounds>::at(const int i, const int j)
 {
-  assert(i > 0 && i <= get_m());
-  assert(j > 0 && j <= get_n());
-  return v_[pos(i, j)];
+  Bounds::check(i > 0 && i <= get_m() && j > 0 && j <= get_n());
+  return v_.data()[pos(i, j)];
 }
 
 
 
-template<class T>
+template<class T, class Bounds>
 T&
-matrix_t<T>::operator()(const int i, const int j)
+matrix_t<T, Bounds>::operator()(const int i, const int j)
 {
   return at(i, j);
 }
 
 
 
-template<class T>
+template<class T, class Bounds>
 const T&
-matrix_t<T>::at(const int i, const int j) const
+matrix_t<T, Bounds>::at(const int i, const int j) const
 {
-  assert(i > 0 && i <= get_m());
-  assert(j > 0 && j <= get_n());
-  return v_[pos(i, j)];
+  Bounds::check(i > 0 && i <= get_m() && j > 0 && j <= get_n());
+  return v_.data()[pos(i, j)];
 }
 
 
 
-template<class T>
+template<class T, class Bounds>
 const T&
-matrix_t<T>::operator()(const int i, const int j) const
+matrix_t<T, Bounds>::operator()(const int i, const int j) const
 {
   return at(i, j);
 }
 
 
 
-template<class T>
+template<class T, class Bounds>
+inline raw_span_t<T>
+matrix_t<T, Bounds>::row(const int i)
+{
+  Bounds::check(i > 0 && i <= get_m());
+  return raw_span_t<T>(v_.data() + (i - 1) * get_n(), get_n());
+}
+
+
+
+template<class T, class Bounds>
+inline raw_span_t<const T>
+matrix_t<T, Bounds>::row(const int i) const
+{
+  Bounds::check(i > 0 && i <= get_m());
+  return raw_span_t<const T>(v_.data() + (i - 1) * get_n(), get_n());
+}
+
+
+
+template<class T, class Bounds>
+inline raw_span_t<T>
+matrix_t<T, Bounds>::span(void)
+{
+  return v_.span();
+}
+
+
+
+template<class T, class Bounds>
+inline raw_span_t<const T>
+matrix_t<T, Bounds>::span(void) const
+{
+  return v_.span();
+}
+
+
+
+// '\n' y no endl: vaciar el buffer en cada fila hace muy lenta la salida de
+// matrices grandes
+template<class T, class Bounds>
 void
-matrix_t<T>::write(ostream& os) const
+matrix_t<T, Bounds>::write(ostream& os) const
 { 
-  os << get_m() << "x" << get_n() << endl;
+  os << get_m() << "x" << get_n() << '\n';
   for (int i = 1; i <= get_m(); ++i) {
     for (int j = 1; j <= get_n(); ++j)
       os << at(i, j) << "\t";
-    os << endl;
+    os << '\n';
   }
-  os << endl;
+  os << '\n';
 }
 
 
 
-template<class T>
+template<class T, class Bounds>
 void
-matrix_t<T>::read(istream& is)
+matrix_t<T, Bounds>::read(istream& is)
 {
   is >> m_ >> n_;
   resize(m_, n_);
@@ -171,30 +314,46 @@ matrix_t<T>::read(istream& is)
 }
 
 
-template<class T>
+// los índices ya los ha comprobado quien llama, según Bounds
+template<class T, class Bounds>
 inline
 int
-matrix_t<T>::pos(const int i, const int j) const
+matrix_t<T, Bounds>::pos(const int i, const int j) const
 {
-  assert(i > 0 && i <= get_m());
-  assert(j > 0 && j <= get_n());
   return (i - 1) * get_n() + (j - 1);
 }
 
 
 
 // FASE III: producto matricial
-template<class T>
+// Para tipos aritméticos se usa el producto por bloques de gemm.hpp, en
+// paralelo y/o con Strassen-Winograd si options lo pide; para el resto
+// (p. ej. rational_t) se mantiene el triple bucle i-j-k.
+template<class T, class Bounds>
 void
-matrix_t<T>::multiply(const matrix_t<T>& A, const matrix_t<T>& B)
+matrix_t<T, Bounds>::multiply(const matrix_t<T, Bounds>& A, const matrix_t<T, Bounds>& B,
+                      const gemm_options_t& options)
 {
   assert(A.get_n() == B.get_m());
   resize(A.get_m(), B.get_n());
+  if constexpr (is_arithmetic<T>::value) {
+    const int m = A.get_m(), n = B.get_n(), k = A.get_n();
+    if (options.strassen)
+      gemm_strassen(m, n, k, A.v_.data(), k, B.v_.data(), n, v_.data(), n, options);
+    else
+      gemm_parallel(m, n, k, A.v_.data(), k, B.v_.data(), n, v_.data(), n, options);
+    return;
+  }
+  // las dimensiones ya están comprobadas: el bucle va sobre los buffers
+  const raw_span_t<const T> b = B.span();
+  const int n = B.get_n();
   for(int i = 1; i <= A.get_m(); i++) {
-    for(int j = 1; j <= B.get_n(); j++) {
-      at(i,j) = 0;
-      for(int k = 1; k <= A.get_n(); k++) {
-        at(i,j) = at(i,j) + A.at(i,k) * B.at(k,j);
+    const raw_span_t<const T> a = A.row(i);
+    const raw_span_t<T> c = row(i);
+    for(int j = 0; j < n; j++) {
+      c[j] = 0;
+      for(int k = 0; k < A.get_n(); k++) {
+        c[j] = c[j] + a[k] * b[k * n + j];
       }
     }
   }
@@ -203,9 +362,9 @@ matrix_t<T>::multiply(const matrix_t<T>& A, const matrix_t<T>& B)
 //MODI: Desarrollar un método de la clase "matrix" que devuelva el vector que contenga su diagonal principal. Su cabecera debe ser:
 //template <classT> vector_t<T> matrix_t<T>::main_diagonal(void)
 
-template<class T>
+template<class T, class Bounds>
 vector_t<T>
-matrix_t<T>::main_diagonal(void)
+matrix_t<T, Bounds>::main_diagonal(void)
 {
   int min_dim = (get_m() < get_n()) ? get_m() : get_n();
   vector_t<T> diag(min_dim);
@@ -56,7 +56,6 @@ rational_t::set_den(const int d)
 
 
 
-inline
 double
 rational_t::value() const
 { 
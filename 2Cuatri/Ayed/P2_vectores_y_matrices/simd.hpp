@@ -0,0 +1,492 @@
+// AUTOR:
+// FECHA:
+// EMAIL:
+// VERSION: 1.0
+// ASIGNATURA: Algoritmos y Estructuras de Datos
+// PRÁCTICA Nº: 2
+// COMENTARIOS: núcleos vectoriales (SSE2, AVX2 y AVX-512) para float y double,
+//              elegidos en tiempo de ejecución según la CPU. Los usan
+//              scal_prod (vector_t.hpp) y el micronúcleo de gemm.hpp.
+//              La variable de entorno SIMD_ISA=scalar|sse2|avx2|avx512
+//              permite forzar un nivel inferior al detectado. Fuera de x86
+//              solo se compilan los núcleos escalares.
+
+// pauta de estilo [92]: comentarios multilínea usando solo "//"
+
+#pragma once
+
+#include <cstdlib>
+#include <cstring>
+
+// los intrínsecos solo existen en x86; en 32 bits además hace falta -msse2
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define SIMD_X86
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// pauta de estilo [5]: el micronúcleo calcula bloques de C de 4 x 8
+const int SIMD_KERNEL_MR = 4;
+const int SIMD_KERNEL_NR = 8;
+
+enum simd_isa_t { SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2, SIMD_AVX512 };
+
+
+
+inline simd_isa_t
+simd_detect(void)
+{
+#ifdef SIMD_X86
+  simd_isa_t isa = SIMD_SSE2;
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    isa = SIMD_AVX2;
+  if (isa == SIMD_AVX2 && __builtin_cpu_supports("avx512f"))
+    isa = SIMD_AVX512;
+#else
+  simd_isa_t isa = SIMD_SCALAR;
+#endif
+
+  const char* forced = getenv("SIMD_ISA");
+  if (forced != NULL) {
+    if (strcmp(forced, "scalar") == 0)
+      isa = SIMD_SCALAR;
+    else if (strcmp(forced, "sse2") == 0 && isa > SIMD_SSE2)
+      isa = SIMD_SSE2;
+    else if (strcmp(forced, "avx2") == 0 && isa > SIMD_AVX2)
+      isa = SIMD_AVX2;
+  }
+  return isa;
+}
+
+
+
+// nivel de la CPU, calculado una sola vez
+inline simd_isa_t
+simd_isa(void)
+{
+  static const simd_isa_t isa = simd_detect();
+  return isa;
+}
+
+
+
+// ---------------------------------------------------------------------------
+// Producto escalar: cuatro acumuladores independientes para no esperar a la
+// latencia de cada suma, y el resto (n no múltiplo del ancho) en escalar.
+// ---------------------------------------------------------------------------
+
+template<class T>
+inline T
+simd_dot_scalar(const T* x, const T* y, const int n)
+{
+  T s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    s0 += x[i] * y[i];
+    s1 += x[i + 1] * y[i + 1];
+    s2 += x[i + 2] * y[i + 2];
+    s3 += x[i + 3] * y[i + 3];
+  }
+  T r = (s0 + s1) + (s2 + s3);
+  for (; i < n; ++i)
+    r += x[i] * y[i];
+  return r;
+}
+
+
+
+#ifdef SIMD_X86
+inline double
+simd_dot_sse2(const double* x, const double* y, const int n)
+{
+  __m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd();
+  __m128d s2 = _mm_setzero_pd(), s3 = _mm_setzero_pd();
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    s0 = _mm_add_pd(s0, _mm_mul_pd(_mm_loadu_pd(x + i), _mm_loadu_pd(y + i)));
+    s1 = _mm_add_pd(s1, _mm_mul_pd(_mm_loadu_pd(x + i + 2), _mm_loadu_pd(y + i + 2)));
+    s2 = _mm_add_pd(s2, _mm_mul_pd(_mm_loadu_pd(x + i + 4), _mm_loadu_pd(y + i + 4)));
+    s3 = _mm_add_pd(s3, _mm_mul_pd(_mm_loadu_pd(x + i + 6), _mm_loadu_pd(y + i + 6)));
+  }
+  __m128d s = _mm_add_pd(_mm_add_pd(s0, s1), _mm_add_pd(s2, s3));
+  double r = _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+  for (; i < n; ++i)
+    r += x[i] * y[i];
+  return r;
+}
+
+
+
+__attribute__((target("avx2,fma")))
+inline double
+simd_dot_avx2(const double* x, const double* y, const int n)
+{
+  __m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+  __m256d s2 = _mm256_setzero_pd(), s3 = _mm256_setzero_pd();
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    s0 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i), s0);
+    s1 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i + 4), _mm256_loadu_pd(y + i + 4), s1);
+    s2 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i + 8), _mm256_loadu_pd(y + i + 8), s2);
+    s3 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i + 12), _mm256_loadu_pd(y + i + 12), s3);
+  }
+  __m256d s = _mm256_add_pd(_mm256_add_pd(s0, s1), _mm256_add_pd(s2, s3));
+  __m128d h = _mm_add_pd(_mm256_castpd256_pd128(s), _mm256_extractf128_pd(s, 1));
+  double r = _mm_cvtsd_f64(_mm_add_sd(h, _mm_unpackhi_pd(h, h)));
+  for (; i < n; ++i)
+    r += x[i] * y[i];
+  return r;
+}
+
+
+
+__attribute__((target("avx512f")))
+inline double
+simd_dot_avx512(const double* x, const double* y, const int n)
+{
+  __m512d s0 = _mm512_setzero_pd(), s1 = _mm512_setzero_pd();
+  __m512d s2 = _mm512_setzero_pd(), s3 = _mm512_setzero_pd();
+  int i = 0;
+  for (; i + 32 <= n; i += 32) {
+    s0 = _mm512_fmadd_pd(_mm512_loadu_pd(x + i), _mm512_loadu_pd(y + i), s0);
+    s1 = _mm512_fmadd_pd(_mm512_loadu_pd(x + i + 8), _mm512_loadu_pd(y + i + 8), s1);
+    s2 = _mm512_fmadd_pd(_mm512_loadu_pd(x + i + 16), _mm512_loadu_pd(y + i + 16), s2);
+    s3 = _mm512_fmadd_pd(_mm512_loadu_pd(x + i + 24), _mm512_loadu_pd(y + i + 24), s3);
+  }
+  // _mm512_reduce_add_pd da un falso aviso de -Wuninitialized en GCC 12
+  double lanes[8];
+  _mm512_storeu_pd(lanes, _mm512_add_pd(_mm512_add_pd(s0, s1), _mm512_add_pd(s2, s3)));
+  double r = 0.0;
+  for (int l = 0; l < 8; ++l)
+    r += lanes[l];
+  for (; i < n; ++i)
+    r += x[i] * y[i];
+  return r;
+}
+
+
+
+inline float
+simd_dot_sse2(const float* x, const float* y, const int n)
+{
+  __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+  __m128 s2 = _mm_setzero_ps(), s3 = _mm_setzero_ps();
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(y + i)));
+    s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(x + i + 4), _mm_loadu_ps(y + i + 4)));
+    s2 = _mm_add_ps(s2, _mm_mul_ps(_mm_loadu_ps(x + i + 8), _mm_loadu_ps(y + i + 8)));
+    s3 = _mm_add_ps(s3, _mm_mul_ps(_mm_loadu_ps(x + i + 12), _mm_loadu_ps(y + i + 12)));
+  }
+  __m128 s = _mm_add_ps(_mm_add_ps(s0, s1), _mm_add_ps(s2, s3));
+  s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+  float r = _mm_cvtss_f32(_mm_add_ss(s, _mm_shuffle_ps(s, s, 1)));
+  for (; i < n; ++i)
+    r += x[i] * y[i];
+  return r;
+}
+
+
+
+__attribute__((target("avx2,fma")))
+inline float
+simd_dot_avx2(const float* x, const float* y, const int n)
+{
+  __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+  __m256 s2 = _mm256_setzero_ps(), s3 = _mm256_setzero_ps();
+  int i = 0;
+  for (; i + 32 <= n; i += 32) {
+    s0 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), s0);
+    s1 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i + 8), _mm256_loadu_ps(y + i + 8), s1);
+    s2 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i + 16), _mm256_loadu_ps(y + i + 16), s2);
+    s3 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i + 24), _mm256_loadu_ps(y + i + 24), s3);
+  }
+  __m256 s8 = _mm256_add_ps(_mm256_add_ps(s0, s1), _mm256_add_ps(s2, s3));
+  __m128 s = _mm_add_ps(_mm256_castps256_ps128(s8), _mm256_extractf128_ps(s8, 1));
+  s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+  float r = _mm_cvtss_f32(_mm_add_ss(s, _mm_shuffle_ps(s, s, 1)));
+  for (; i < n; ++i)
+    r += x[i] * y[i];
+  return r;
+}
+
+
+
+__attribute__((target("avx512f")))
+inline float
+simd_dot_avx512(const float* x, const float* y, const int n)
+{
+  __m512 s0 = _mm512_setzero_ps(), s1 = _mm512_setzero_ps();
+  __m512 s2 = _mm512_setzero_ps(), s3 = _mm512_setzero_ps();
+  int i = 0;
+  for (; i + 64 <= n; i += 64) {
+    s0 = _mm512_fmadd_ps(_mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i), s0);
+    s1 = _mm512_fmadd_ps(_mm512_loadu_ps(x + i + 16), _mm512_loadu_ps(y + i + 16), s1);
+    s2 = _mm512_fmadd_ps(_mm512_loadu_ps(x + i + 32), _mm512_loadu_ps(y + i + 32), s2);
+    s3 = _mm512_fmadd_ps(_mm512_loadu_ps(x + i + 48), _mm512_loadu_ps(y + i + 48), s3);
+  }
+  float lanes[16];
+  _mm512_storeu_ps(lanes, _mm512_add_ps(_mm512_add_ps(s0, s1), _mm512_add_ps(s2, s3)));
+  float r = 0.0f;
+  for (int l = 0; l < 16; ++l)
+    r += lanes[l];
+  for (; i < n; ++i)
+    r += x[i] * y[i];
+  return r;
+}
+
+
+
+#endif
+
+
+
+template<class T>
+inline T
+simd_dot(const T* x, const T* y, const int n)
+{
+  switch (simd_isa()) {
+#ifdef SIMD_X86
+    case SIMD_AVX512: return simd_dot_avx512(x, y, n);
+    case SIMD_AVX2:   return simd_dot_avx2(x, y, n);
+    case SIMD_SSE2:   return simd_dot_sse2(x, y, n);
+#endif
+    default:          return simd_dot_scalar(x, y, n);
+  }
+}
+
+
+
+// ---------------------------------------------------------------------------
+// Micronúcleo de GEMM: tile[0:4][0:8] = suma sobre p de a[p] * b[p]^T, con a
+// un panel empaquetado de 4 filas y b uno de 8 columnas (ver gemm.hpp).
+// Cada fila de C va en registros; a[i] se difunde a todo el registro.
+// ---------------------------------------------------------------------------
+
+template<class T>
+inline void
+simd_gemm_kernel_scalar(const int kc, const T* a, const T* b, T* tile)
+{
+  T c[SIMD_KERNEL_MR][SIMD_KERNEL_NR] = {};
+  for (int p = 0; p < kc; ++p) {
+    for (int i = 0; i < SIMD_KERNEL_MR; ++i)
+      for (int j = 0; j < SIMD_KERNEL_NR; ++j)
+        c[i][j] += a[i] * b[j];
+    a += SIMD_KERNEL_MR;
+    b += SIMD_KERNEL_NR;
+  }
+
+  for (int i = 0; i < SIMD_KERNEL_MR; ++i)
+    for (int j = 0; j < SIMD_KERNEL_NR; ++j)
+      tile[i * SIMD_KERNEL_NR + j] = c[i][j];
+}
+
+
+
+#ifdef SIMD_X86
+inline void
+simd_gemm_kernel_sse2(const int kc, const double* a, const double* b, double* tile)
+{
+  __m128d c[SIMD_KERNEL_MR][4];
+  for (int i = 0; i < SIMD_KERNEL_MR; ++i)
+    for (int j = 0; j < 4; ++j)
+      c[i][j] = _mm_setzero_pd();
+
+  for (int p = 0; p < kc; ++p) {
+    __m128d b0 = _mm_loadu_pd(b), b1 = _mm_loadu_pd(b + 2);
+    __m128d b2 = _mm_loadu_pd(b + 4), b3 = _mm_loadu_pd(b + 6);
+    for (int i = 0; i < SIMD_KERNEL_MR; ++i) {
+      __m128d ai = _mm_set1_pd(a[i]);
+      c[i][0] = _mm_add_pd(c[i][0], _mm_mul_pd(ai, b0));
+      c[i][1] = _mm_add_pd(c[i][1], _mm_mul_pd(ai, b1));
+      c[i][2] = _mm_add_pd(c[i][2], _mm_mul_pd(ai, b2));
+      c[i][3] = _mm_add_pd(c[i][3], _mm_mul_pd(ai, b3));
+    }
+    a += SIMD_KERNEL_MR;
+    b += SIMD_KERNEL_NR;
+  }
+
+  for (int i = 0; i < SIMD_KERNEL_MR; ++i)
+    for (int j = 0; j < 4; ++j)
+      _mm_storeu_pd(tile + i * SIMD_KERNEL_NR + 2 * j, c[i][j]);
+}
+
+
+
+__attribute__((target("avx2,fma")))
+inline void
+simd_gemm_kernel_avx2(const int kc, const double* a, const double* b, double* tile)
+{
+  __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd();
+  __m256d c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+  __m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd();
+  __m256d c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+
+  for (int p = 0; p < kc; ++p) {
+    __m256d b0 = _mm256_loadu_pd(b), b1 = _mm256_loadu_pd(b + 4);
+    __m256d ai = _mm256_broadcast_sd(a);
+    c00 = _mm256_fmadd_pd(ai, b0, c00);
+    c01 = _mm256_fmadd_pd(ai, b1, c01);
+    ai = _mm256_broadcast_sd(a + 1);
+    c10 = _mm256_fmadd_pd(ai, b0, c10);
+    c11 = _mm256_fmadd_pd(ai, b1, c11);
+    ai = _mm256_broadcast_sd(a + 2);
+    c20 = _mm256_fmadd_pd(ai, b0, c20);
+    c21 = _mm256_fmadd_pd(ai, b1, c21);
+    ai = _mm256_broadcast_sd(a + 3);
+    c30 = _mm256_fmadd_pd(ai, b0, c30);
+    c31 = _mm256_fmadd_pd(ai, b1, c31);
+    a += SIMD_KERNEL_MR;
+    b += SIMD_KERNEL_NR;
+  }
+
+  _mm256_storeu_pd(tile, c00);      _mm256_storeu_pd(tile + 4, c01);
+  _mm256_storeu_pd(tile + 8, c10);  _mm256_storeu_pd(tile + 12, c11);
+  _mm256_storeu_pd(tile + 16, c20); _mm256_storeu_pd(tile + 20, c21);
+  _mm256_storeu_pd(tile + 24, c30); _mm256_storeu_pd(tile + 28, c31);
+}
+
+
+
+// Una fila de 8 double ocupa un solo registro, así que se alternan dos juegos
+// de acumuladores (p par e impar) para tener 8 FMA independientes en vuelo.
+__attribute__((target("avx512f")))
+inline void
+simd_gemm_kernel_avx512(const int kc, const double* a, const double* b, double* tile)
+{
+  __m512d c0 = _mm512_setzero_pd(), c1 = _mm512_setzero_pd();
+  __m512d c2 = _mm512_setzero_pd(), c3 = _mm512_setzero_pd();
+  __m512d d0 = _mm512_setzero_pd(), d1 = _mm512_setzero_pd();
+  __m512d d2 = _mm512_setzero_pd(), d3 = _mm512_setzero_pd();
+
+  int p = 0;
+  for (; p + 2 <= kc; p += 2) {
+    __m512d b0 = _mm512_loadu_pd(b), b1 = _mm512_loadu_pd(b + SIMD_KERNEL_NR);
+    c0 = _mm512_fmadd_pd(_mm512_set1_pd(a[0]), b0, c0);
+    c1 = _mm512_fmadd_pd(_mm512_set1_pd(a[1]), b0, c1);
+    c2 = _mm512_fmadd_pd(_mm512_set1_pd(a[2]), b0, c2);
+    c3 = _mm512_fmadd_pd(_mm512_set1_pd(a[3]), b0, c3);
+    d0 = _mm512_fmadd_pd(_mm512_set1_pd(a[4]), b1, d0);
+    d1 = _mm512_fmadd_pd(_mm512_set1_pd(a[5]), b1, d1);
+    d2 = _mm512_fmadd_pd(_mm512_set1_pd(a[6]), b1, d2);
+    d3 = _mm512_fmadd_pd(_mm512_set1_pd(a[7]), b1, d3);
+    a += 2 * SIMD_KERNEL_MR;
+    b += 2 * SIMD_KERNEL_NR;
+  }
+  if (p < kc) {
+    __m512d b0 = _mm512_loadu_pd(b);
+    c0 = _mm512_fmadd_pd(_mm512_set1_pd(a[0]), b0, c0);
+    c1 = _mm512_fmadd_pd(_mm512_set1_pd(a[1]), b0, c1);
+    c2 = _mm512_fmadd_pd(_mm512_set1_pd(a[2]), b0, c2);
+    c3 = _mm512_fmadd_pd(_mm512_set1_pd(a[3]), b0, c3);
+  }
+
+  _mm512_storeu_pd(tile, _mm512_add_pd(c0, d0));
+  _mm512_storeu_pd(tile + 8, _mm512_add_pd(c1, d1));
+  _mm512_storeu_pd(tile + 16, _mm512_add_pd(c2, d2));
+  _mm512_storeu_pd(tile + 24, _mm512_add_pd(c3, d3));
+}
+
+
+
+inline void
+simd_gemm_kernel_sse2(const int kc, const float* a, const float* b, float* tile)
+{
+  __m128 c[SIMD_KERNEL_MR][2];
+  for (int i = 0; i < SIMD_KERNEL_MR; ++i)
+    c[i][0] = c[i][1] = _mm_setzero_ps();
+
+  for (int p = 0; p < kc; ++p) {
+    __m128 b0 = _mm_loadu_ps(b), b1 = _mm_loadu_ps(b + 4);
+    for (int i = 0; i < SIMD_KERNEL_MR; ++i) {
+      __m128 ai = _mm_set1_ps(a[i]);
+      c[i][0] = _mm_add_ps(c[i][0], _mm_mul_ps(ai, b0));
+      c[i][1] = _mm_add_ps(c[i][1], _mm_mul_ps(ai, b1));
+    }
+    a += SIMD_KERNEL_MR;
+    b += SIMD_KERNEL_NR;
+  }
+
+  for (int i = 0; i < SIMD_KERNEL_MR; ++i) {
+    _mm_storeu_ps(tile + i * SIMD_KERNEL_NR, c[i][0]);
+    _mm_storeu_ps(tile + i * SIMD_KERNEL_NR + 4, c[i][1]);
+  }
+}
+
+
+
+// Como en el caso double de AVX-512, una fila cabe en un registro y se
+// alternan dos juegos de acumuladores. AVX-512 no aporta nada con filas de 8
+// float, así que ese nivel usa también este núcleo.
+__attribute__((target("avx2,fma")))
+inline void
+simd_gemm_kernel_avx2(const int kc, const float* a, const float* b, float* tile)
+{
+  __m256 c0 = _mm256_setzero_ps(), c1 = _mm256_setzero_ps();
+  __m256 c2 = _mm256_setzero_ps(), c3 = _mm256_setzero_ps();
+  __m256 d0 = _mm256_setzero_ps(), d1 = _mm256_setzero_ps();
+  __m256 d2 = _mm256_setzero_ps(), d3 = _mm256_setzero_ps();
+
+  int p = 0;
+  for (; p + 2 <= kc; p += 2) {
+    __m256 b0 = _mm256_loadu_ps(b), b1 = _mm256_loadu_ps(b + SIMD_KERNEL_NR);
+    c0 = _mm256_fmadd_ps(_mm256_broadcast_ss(a), b0, c0);
+    c1 = _mm256_fmadd_ps(_mm256_broadcast_ss(a + 1), b0, c1);
+    c2 = _mm256_fmadd_ps(_mm256_broadcast_ss(a + 2), b0, c2);
+    c3 = _mm256_fmadd_ps(_mm256_broadcast_ss(a + 3), b0, c3);
+    d0 = _mm256_fmadd_ps(_mm256_broadcast_ss(a + 4), b1, d0);
+    d1 = _mm256_fmadd_ps(_mm256_broadcast_ss(a + 5), b1, d1);
+    d2 = _mm256_fmadd_ps(_mm256_broadcast_ss(a + 6), b1, d2);
+    d3 = _mm256_fmadd_ps(_mm256_broadcast_ss(a + 7), b1, d3);
+    a += 2 * SIMD_KERNEL_MR;
+    b += 2 * SIMD_KERNEL_NR;
+  }
+  if (p < kc) {
+    __m256 b0 = _mm256_loadu_ps(b);
+    c0 = _mm256_fmadd_ps(_mm256_broadcast_ss(a), b0, c0);
+    c1 = _mm256_fmadd_ps(_mm256_broadcast_ss(a + 1), b0, c1);
+    c2 = _mm256_fmadd_ps(_mm256_broadcast_ss(a + 2), b0, c2);
+    c3 = _mm256_fmadd_ps(_mm256_broadcast_ss(a + 3), b0, c3);
+  }
+
+  _mm256_storeu_ps(tile, _mm256_add_ps(c0, d0));
+  _mm256_storeu_ps(tile + 8, _mm256_add_ps(c1, d1));
+  _mm256_storeu_ps(tile + 16, _mm256_add_ps(c2, d2));
+  _mm256_storeu_ps(tile + 24, _mm256_add_ps(c3, d3));
+}
+
+
+
+#endif
+
+
+
+inline void
+simd_gemm_kernel(const int kc, const double* a, const double* b, double* tile)
+{
+  switch (simd_isa()) {
+#ifdef SIMD_X86
+    case SIMD_AVX512: simd_gemm_kernel_avx512(kc, a, b, tile); break;
+    case SIMD_AVX2:   simd_gemm_kernel_avx2(kc, a, b, tile); break;
+    case SIMD_SSE2:   simd_gemm_kernel_sse2(kc, a, b, tile); break;
+#endif
+    default:          simd_gemm_kernel_scalar(kc, a, b, tile); break;
+  }
+}
+
+
+
+inline void
+simd_gemm_kernel(const int kc, const float* a, const float* b, float* tile)
+{
+  switch (simd_isa()) {
+#ifdef SIMD_X86
+    case SIMD_AVX512:
+    case SIMD_AVX2:   simd_gemm_kernel_avx2(kc, a, b, tile); break;
+    case SIMD_SSE2:   simd_gemm_kernel_sse2(kc, a, b, tile); break;
+#endif
+    default:          simd_gemm_kernel_scalar(kc, a, b, tile); break;
+  }
+}
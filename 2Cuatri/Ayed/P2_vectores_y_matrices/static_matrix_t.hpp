@@ -0,0 +1,249 @@
+// AUTOR:
+// FECHA:
+// EMAIL:
+// VERSION: 1.0
+// ASIGNATURA: Algoritmos y Estructuras de Datos
+// PRÁCTICA Nº: 2
+// COMENTARIOS: matrices de tamaño fijo M x N (3x3, 4x4...) con los elementos
+//              dentro del propio objeto, sin memoria dinámica. Como M, N y K
+//              se conocen al compilar, el producto se desenrolla entero y, con
+//              optimización, se queda en registros; si los operandos son
+//              constantes se puede calcular en compilación:
+//
+//                constexpr static_matrix_t<int, 2, 2> A(1, 2,
+//                                                       3, 4);
+//                static_assert((A * A)(2, 2) == 22);
+//
+//              Se indexa desde 1 como matrix_t y es una expresión matricial
+//              (expr.hpp), así que se puede asignar a un matrix_t o usar en
+//              expresiones con ellos; también se construye desde un matrix_t
+//              de las mismas dimensiones.
+
+// pauta de estilo [92]: comentarios multilínea usando solo "//"
+
+#pragma once
+
+#include <iostream>
+#include <cassert>
+#include <type_traits>
+#include <utility>
+
+#include "bounds.hpp"
+#include "expr.hpp"
+#include "matrix_t.hpp"
+
+using namespace std;
+
+template<class T, int M, int N, class Bounds = checked_bounds_t>
+class static_matrix_t : public matrix_expr_t<static_matrix_t<T, M, N, Bounds>>
+{
+  static_assert(M > 0 && N > 0, "static_matrix_t: dimensiones nulas");
+
+public:
+  typedef T value_type;
+
+  constexpr static_matrix_t(void);  // todo a cero
+
+  // los M * N elementos, por filas
+  template<class... U,
+           class = enable_if_t<sizeof...(U) == M * N && (M * N > 1) &&
+                               (is_convertible<U, T>::value && ...)>>
+  constexpr static_matrix_t(const U&...);
+
+  template<class B> explicit static_matrix_t(const matrix_t<T, B>&);
+  template<class E> static_matrix_t<T, M, N, Bounds>& operator=(const matrix_expr_t<E>&);
+
+  // getters
+  static constexpr int get_m(void) { return M; }
+  static constexpr int get_n(void) { return N; }
+
+  // getters-setters
+  constexpr T& at(const int, const int);
+  constexpr T& operator()(const int, const int);
+
+  // getters constantes
+  constexpr const T& at(const int, const int) const;
+  constexpr const T& operator()(const int, const int) const;
+
+  // this = A * B
+  template<int K>
+  constexpr void multiply(const static_matrix_t<T, M, K, Bounds>&,
+                          const static_matrix_t<T, K, N, Bounds>&);
+
+  void write(ostream& = cout) const;
+
+private:
+  T v_[M * N];  // por filas, como matrix_t
+
+  template<int K, size_t... P>
+  static constexpr T dot_(const static_matrix_t<T, M, K, Bounds>&,
+                          const static_matrix_t<T, K, N, Bounds>&,
+                          const int, const int, index_sequence<P...>);
+
+  template<int K, size_t... IJ>
+  constexpr void multiply_(const static_matrix_t<T, M, K, Bounds>&,
+                           const static_matrix_t<T, K, N, Bounds>&,
+                           index_sequence<IJ...>);
+
+  template<class, int, int, class> friend class static_matrix_t;
+};
+
+
+
+// en los nodos de una expresión se guarda por referencia, como matrix_t
+template<class T, int M, int N, class Bounds>
+struct expr_ref_t<static_matrix_t<T, M, N, Bounds>>
+{
+  typedef const static_matrix_t<T, M, N, Bounds>& type;
+};
+
+
+
+template<class T, int M, int N, class Bounds>
+constexpr
+static_matrix_t<T, M, N, Bounds>::static_matrix_t(void) : v_{}
+{}
+
+
+
+template<class T, int M, int N, class Bounds>
+template<class... U, class>
+constexpr
+static_matrix_t<T, M, N, Bounds>::static_matrix_t(const U&... values)
+  : v_{T(values)...}
+{}
+
+
+
+template<class T, int M, int N, class Bounds>
+template<class B>
+static_matrix_t<T, M, N, Bounds>::static_matrix_t(const matrix_t<T, B>& A)
+{
+  assert(A.get_m() == M && A.get_n() == N);
+  for (int i = 1; i <= M; ++i)
+    for (int j = 1; j <= N; ++j)
+      at(i, j) = A(i, j);
+}
+
+
+
+// Los elementos se escriben en cuanto se calculan: si la expresión lee esta
+// misma matriz, solo puede hacerlo elemento a elemento (como en matrix_t).
+template<class T, int M, int N, class Bounds>
+template<class E>
+static_matrix_t<T, M, N, Bounds>&
+static_matrix_t<T, M, N, Bounds>::operator=(const matrix_expr_t<E>& e)
+{
+  const E& expr = e.self();
+  assert(expr.get_m() == M && expr.get_n() == N);
+  for (int i = 1; i <= M; ++i)
+    for (int j = 1; j <= N; ++j)
+      at(i, j) = expr(i, j);
+  return *this;
+}
+
+
+
+template<class T, int M, int N, class Bounds>
+constexpr T&
+static_matrix_t<T, M, N, Bounds>::at(const int i, const int j)
+{
+  Bounds::check(i > 0 && i <= M && j > 0 && j <= N);
+  return v_[(i - 1) * N + (j - 1)];
+}
+
+
+
+template<class T, int M, int N, class Bounds>
+constexpr T&
+static_matrix_t<T, M, N, Bounds>::operator()(const int i, const int j)
+{
+  return at(i, j);
+}
+
+
+
+template<class T, int M, int N, class Bounds>
+constexpr const T&
+static_matrix_t<T, M, N, Bounds>::at(const int i, const int j) const
+{
+  Bounds::check(i > 0 && i <= M && j > 0 && j <= N);
+  return v_[(i - 1) * N + (j - 1)];
+}
+
+
+
+template<class T, int M, int N, class Bounds>
+constexpr const T&
+static_matrix_t<T, M, N, Bounds>::operator()(const int i, const int j) const
+{
+  return at(i, j);
+}
+
+
+
+// Elemento (i, j) del producto, desde 0. El pliegue por la izquierda suma en
+// el mismo orden que el bucle de matrix_t::multiply: ((0 + a0 b0) + a1 b1)...
+template<class T, int M, int N, class Bounds>
+template<int K, size_t... P>
+constexpr T
+static_matrix_t<T, M, N, Bounds>::dot_(const static_matrix_t<T, M, K, Bounds>& A,
+                                       const static_matrix_t<T, K, N, Bounds>& B,
+                                       const int i, const int j, index_sequence<P...>)
+{
+  return (T(0) + ... + (A.v_[i * K + P] * B.v_[P * N + j]));
+}
+
+
+
+template<class T, int M, int N, class Bounds>
+template<int K, size_t... IJ>
+constexpr void
+static_matrix_t<T, M, N, Bounds>::multiply_(const static_matrix_t<T, M, K, Bounds>& A,
+                                            const static_matrix_t<T, K, N, Bounds>& B,
+                                            index_sequence<IJ...>)
+{
+  ((v_[IJ] = dot_(A, B, IJ / N, IJ % N, make_index_sequence<K>())), ...);
+}
+
+
+
+// FASE III: producto matricial, desenrollado en compilación. this no puede
+// ser A ni B.
+template<class T, int M, int N, class Bounds>
+template<int K>
+constexpr void
+static_matrix_t<T, M, N, Bounds>::multiply(const static_matrix_t<T, M, K, Bounds>& A,
+                                           const static_matrix_t<T, K, N, Bounds>& B)
+{
+  assert(static_cast<const void*>(this) != &A && static_cast<const void*>(this) != &B);
+  multiply_(A, B, make_index_sequence<M * N>());
+}
+
+
+
+template<class T, int M, int N, class Bounds>
+void
+static_matrix_t<T, M, N, Bounds>::write(ostream& os) const
+{
+  os << M << "x" << N << '\n';
+  for (int i = 1; i <= M; ++i) {
+    for (int j = 1; j <= N; ++j)
+      os << at(i, j) << "\t";
+    os << '\n';
+  }
+  os << '\n';
+}
+
+
+
+// A * B como valor, para poder usarlo en expresiones constantes
+template<class T, int M, int K, int N, class Bounds>
+constexpr static_matrix_t<T, M, N, Bounds>
+operator*(const static_matrix_t<T, M, K, Bounds>& A,
+          const static_matrix_t<T, K, N, Bounds>& B)
+{
+  static_matrix_t<T, M, N, Bounds> C;
+  C.multiply(A, B);
+  return C;
+}
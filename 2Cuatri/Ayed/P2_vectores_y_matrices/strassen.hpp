@@ -0,0 +1,216 @@
+// AUTOR:
+// FECHA:
+// EMAIL:
+// VERSION: 1.0
+// ASIGNATURA: Algoritmos y Estructuras de Datos
+// PRÁCTICA Nº: 2
+// COMENTARIOS: producto de matrices de Strassen-Winograd (7 productos y 15
+//              sumas por nivel) para matrices grandes. Baja recursivamente
+//              hasta que la dimensión menor no pasa de STRASSEN_CUTOFF y ahí
+//              usa el producto por bloques de gemm.hpp.
+//
+//              Error: a diferencia del producto clásico, la cota ya no es
+//              elemento a elemento sino en norma:
+//                ||C - fl(C)|| <= [(n / n0)^log2(18) (n0^2 + 6 n0) - 6 n] u ||A|| ||B||
+//              con n0 el tamaño de corte (Higham, "Accuracy and Stability of
+//              Numerical Algorithms", 23.2.2). En la práctica, con datos
+//              uniformes en [0, 1] y n = 2048, el error relativo máximo frente
+//              al producto clásico es del orden de 1e-15; puede ser mucho peor
+//              si A o B tienen filas o columnas de magnitudes muy distintas.
+//              Con tipos enteros el resultado es exacto.
+
+// pauta de estilo [92]: comentarios multilínea usando solo "//"
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cassert>
+
+#include "gemm.hpp"
+
+using namespace std;
+
+// pauta de estilo [5]: por debajo de este tamaño ahorrarse un producto no
+// compensa las 15 sumas ni el tráfico de memoria. Medido con el núcleo AVX-512
+// en un solo hilo: con n = 2048 y 4096 el mejor corte es 1024 (un 17-19% más
+// rápido que el producto clásico); con 512 ya gana menos.
+const int STRASSEN_CUTOFF = 1024;
+
+
+
+// Memoria para los temporales de todos los niveles, reservada de una vez.
+// Se usa como una pila: cada nivel guarda la marca, pide lo suyo y la
+// restaura al terminar.
+template<class T>
+class strassen_arena_t
+{
+public:
+  strassen_arena_t(const size_t size) : buffer_(size), top_(0) {}
+
+  T* get(const size_t size)
+  {
+    assert(top_ + size <= buffer_.size());
+    T* p = buffer_.data() + top_;
+    top_ += size;
+    return p;
+  }
+
+  size_t mark(void) const { return top_; }
+  void release(const size_t mark) { top_ = mark; }
+
+private:
+  vector<T> buffer_;
+  size_t top_;
+};
+
+
+
+// Z = X + Y sobre bloques de m x n; Z puede ser X o Y
+template<class T>
+void
+strassen_add(const int m, const int n, const T* x, const int ldx,
+             const T* y, const int ldy, T* z, const int ldz)
+{
+  for (int i = 0; i < m; ++i)
+    for (int j = 0; j < n; ++j)
+      z[i * ldz + j] = x[i * ldx + j] + y[i * ldy + j];
+}
+
+
+
+// Z = X - Y sobre bloques de m x n; Z puede ser X o Y
+template<class T>
+void
+strassen_sub(const int m, const int n, const T* x, const int ldx,
+             const T* y, const int ldy, T* z, const int ldz)
+{
+  for (int i = 0; i < m; ++i)
+    for (int j = 0; j < n; ++j)
+      z[i * ldz + j] = x[i * ldx + j] - y[i * ldy + j];
+}
+
+
+
+// Un nivel de Strassen-Winograd con m, n y k divisibles por 2^depth.
+// Orden de operaciones de Douglas et al. (1994): solo hacen falta tres
+// temporales por nivel (X del tamaño de un cuarto de A, Y de uno de B y P de
+// uno de C); el resto de resultados intermedios se guardan en los cuartos de C.
+template<class T>
+void
+strassen_rec(const int m, const int n, const int k,
+             const T* a, const int lda, const T* b, const int ldb,
+             T* c, const int ldc, const int depth,
+             strassen_arena_t<T>& arena, const gemm_options_t& options)
+{
+  if (depth == 0) {
+    gemm_parallel(m, n, k, a, lda, b, ldb, c, ldc, options);
+    return;
+  }
+
+  const int m2 = m / 2, n2 = n / 2, k2 = k / 2;
+  const T* a11 = a;
+  const T* a12 = a + k2;
+  const T* a21 = a + m2 * lda;
+  const T* a22 = a21 + k2;
+  const T* b11 = b;
+  const T* b12 = b + n2;
+  const T* b21 = b + k2 * ldb;
+  const T* b22 = b21 + n2;
+  T* c11 = c;
+  T* c12 = c + n2;
+  T* c21 = c + m2 * ldc;
+  T* c22 = c21 + n2;
+
+  const size_t mark = arena.mark();
+  T* x = arena.get(size_t(m2) * k2);
+  T* y = arena.get(size_t(k2) * n2);
+  T* p = arena.get(size_t(m2) * n2);
+
+  // C21 = M7 = (A11 - A21) (B22 - B12)
+  strassen_sub(m2, k2, a11, lda, a21, lda, x, k2);
+  strassen_sub(k2, n2, b22, ldb, b12, ldb, y, n2);
+  strassen_rec(m2, n2, k2, x, k2, y, n2, c21, ldc, depth - 1, arena, options);
+
+  // C22 = M5 = S1 T1, con S1 = A21 + A22 y T1 = B12 - B11
+  strassen_add(m2, k2, a21, lda, a22, lda, x, k2);
+  strassen_sub(k2, n2, b12, ldb, b11, ldb, y, n2);
+  strassen_rec(m2, n2, k2, x, k2, y, n2, c22, ldc, depth - 1, arena, options);
+
+  // C12 = M6 = S2 T2, con S2 = S1 - A11 y T2 = B22 - T1
+  strassen_sub(m2, k2, x, k2, a11, lda, x, k2);
+  strassen_sub(k2, n2, b22, ldb, y, n2, y, n2);
+  strassen_rec(m2, n2, k2, x, k2, y, n2, c12, ldc, depth - 1, arena, options);
+
+  // C11 = M3 = S4 B22, con S4 = A12 - S2
+  strassen_sub(m2, k2, a12, lda, x, k2, x, k2);
+  strassen_rec(m2, n2, k2, x, k2, b22, ldb, c11, ldc, depth - 1, arena, options);
+
+  // P = M1 = A11 B11
+  strassen_rec(m2, n2, k2, a11, lda, b11, ldb, p, n2, depth - 1, arena, options);
+
+  // U2 = M1 + M6, U3 = U2 + M7, U4 = U2 + M5, U7 = U3 + M5, U5 = U4 + M3
+  strassen_add(m2, n2, p, n2, c12, ldc, c12, ldc);
+  strassen_add(m2, n2, c12, ldc, c21, ldc, c21, ldc);
+  strassen_add(m2, n2, c12, ldc, c22, ldc, c12, ldc);
+  strassen_add(m2, n2, c21, ldc, c22, ldc, c22, ldc);
+  strassen_add(m2, n2, c12, ldc, c11, ldc, c12, ldc);
+
+  // C11 = M4 = A22 T4, con T4 = T2 - B21; C21 = U6 = U3 - M4
+  strassen_sub(k2, n2, y, n2, b21, ldb, y, n2);
+  strassen_rec(m2, n2, k2, a22, lda, y, n2, c11, ldc, depth - 1, arena, options);
+  strassen_sub(m2, n2, c21, ldc, c11, ldc, c21, ldc);
+
+  // C11 = U1 = M1 + M2, con M2 = A12 B21
+  strassen_rec(m2, n2, k2, a12, lda, b21, ldb, c11, ldc, depth - 1, arena, options);
+  strassen_add(m2, n2, p, n2, c11, ldc, c11, ldc);
+
+  arena.release(mark);
+}
+
+
+
+// C = A * B con Strassen-Winograd. Si las dimensiones no son divisibles por
+// 2^profundidad, se rellenan con ceros hasta el siguiente múltiplo (como mucho
+// 2^profundidad - 1 filas o columnas de más) y se copia el resultado.
+template<class T>
+void
+gemm_strassen(const int m, const int n, const int k,
+              const T* a, const int lda, const T* b, const int ldb,
+              T* c, const int ldc, const gemm_options_t& options,
+              const int cutoff = STRASSEN_CUTOFF)
+{
+  int depth = 0;
+  for (int dim = min(m, min(n, k)); dim > cutoff; dim = (dim + 1) / 2)
+    ++depth;
+  if (depth == 0) {
+    gemm_parallel(m, n, k, a, lda, b, ldb, c, ldc, options);
+    return;
+  }
+
+  const int step = 1 << depth;
+  const int pm = (m + step - 1) / step * step;
+  const int pn = (n + step - 1) / step * step;
+  const int pk = (k + step - 1) / step * step;
+
+  size_t arena_size = 0;
+  for (int l = 1; l <= depth; ++l) {
+    const size_t lm = pm >> l, ln = pn >> l, lk = pk >> l;
+    arena_size += lm * lk + lk * ln + lm * ln;
+  }
+  strassen_arena_t<T> arena(arena_size);
+
+  if (pm == m && pn == n && pk == k) {
+    strassen_rec(m, n, k, a, lda, b, ldb, c, ldc, depth, arena, options);
+    return;
+  }
+
+  vector<T> pa(size_t(pm) * pk, T(0)), pb(size_t(pk) * pn, T(0)), pc(size_t(pm) * pn);
+  for (int i = 0; i < m; ++i)
+    copy(a + i * lda, a + i * lda + k, pa.data() + size_t(i) * pk);
+  for (int i = 0; i < k; ++i)
+    copy(b + i * ldb, b + i * ldb + n, pb.data() + size_t(i) * pn);
+  strassen_rec(pm, pn, pk, pa.data(), pk, pb.data(), pn, pc.data(), pn, depth, arena, options);
+  for (int i = 0; i < m; ++i)
+    copy(pc.data() + size_t(i) * pn, pc.data() + size_t(i) * pn + n, c + i * ldc);
+}
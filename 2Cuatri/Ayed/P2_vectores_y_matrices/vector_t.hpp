@@ -12,15 +12,39 @@
 
 #include <iostream>
 #include <cassert>
+#include <utility>
+#include <memory>
+#include <type_traits>
+
+#include "simd.hpp"
+#include "allocator.hpp"
+#include "bounds.hpp"
+#include "expr.hpp"
 
 using namespace std;
 
-template<class T>
-class vector_t
+// Alloc decide de dónde sale la memoria (allocator.hpp); por defecto,
+// aligned_allocator_t<T>. Bounds decide si at(), [], get_val() y set_val()
+// comprueban el índice (bounds.hpp); por defecto, sí. Los valores por defecto
+// están en la declaración adelantada de expr.hpp.
+template<class T, class Alloc, class Bounds>
+class vector_t : public vector_expr_t<vector_t<T, Alloc, Bounds>>
 {
 public:
-  vector_t(const int = 0);
+  typedef T value_type;
+  typedef Alloc allocator_type;
+
+  vector_t(const int = 0, const Alloc& = Alloc());
+  vector_t(const vector_t<T, Alloc, Bounds>&);      // constructor de copia
+  vector_t(vector_t<T, Alloc, Bounds>&&) noexcept;  // constructor de movimiento
   ~vector_t();
+
+  vector_t<T, Alloc, Bounds>& operator=(const vector_t<T, Alloc, Bounds>&);
+  vector_t<T, Alloc, Bounds>& operator=(vector_t<T, Alloc, Bounds>&&) noexcept;
+
+  // construcción y asignación desde una expresión (expr.hpp)
+  template<class E> vector_t(const vector_expr_t<E>&, const Alloc& = Alloc());
+  template<class E> vector_t<T, Alloc, Bounds>& operator=(const vector_expr_t<E>&);
   
   void resize(const int);
   
@@ -39,12 +63,22 @@ public:
   const T& at(const int) const;
   const T& operator[](const int) const;
 
+  // acceso al buffer contiguo, para los núcleos de cálculo
+  T* data(void);
+  const T* data(void) const;
+  raw_span_t<T> span(void);
+  raw_span_t<const T> span(void) const;
+
+  Alloc get_allocator(void) const;
+
   void write(ostream& = cout) const;
   void read(istream& = cin);
 
 private:
   T *v_;
   int sz_;
+  int cap_;  // elementos reservados en v_ (cap_ >= sz_)
+  Alloc alloc_;
   
   void build(void);
   void destroy(void);
@@ -52,52 +86,170 @@ private:
 
 
 
-template<class T>
-vector_t<T>::vector_t(const int n)
+template<class T, class Alloc, class Bounds>
+vector_t<T, Alloc, Bounds>::vector_t(const int n, const Alloc& alloc) : alloc_(alloc)
 { sz_ = n;
   build();
 }
 
 
 
-template<class T>
-vector_t<T>::~vector_t()
+template<class T, class Alloc, class Bounds>
+vector_t<T, Alloc, Bounds>::vector_t(const vector_t<T, Alloc, Bounds>& w)
+  : alloc_(allocator_traits<Alloc>::select_on_container_copy_construction(w.alloc_))
+{
+  sz_ = w.sz_;
+  build();
+  for (int i = 0; i < sz_; ++i)
+    v_[i] = w.v_[i];
+}
+
+
+
+// el nuevo vector se queda con el buffer de w, que queda vacío
+template<class T, class Alloc, class Bounds>
+vector_t<T, Alloc, Bounds>::vector_t(vector_t<T, Alloc, Bounds>&& w) noexcept : alloc_(w.alloc_)
+{
+  v_ = w.v_;
+  sz_ = w.sz_;
+  cap_ = w.cap_;
+  w.v_ = NULL;
+  w.sz_ = 0;
+  w.cap_ = 0;
+}
+
+
+
+template<class T, class Alloc, class Bounds>
+vector_t<T, Alloc, Bounds>::~vector_t()
 {
   destroy();
 }
 
 
 
-template<class T>
+template<class T, class Alloc, class Bounds>
+vector_t<T, Alloc, Bounds>&
+vector_t<T, Alloc, Bounds>::operator=(const vector_t<T, Alloc, Bounds>& w)
+{
+  if (this != &w) {
+    resize(w.sz_);
+    for (int i = 0; i < sz_; ++i)
+      v_[i] = w.v_[i];
+  }
+  return *this;
+}
+
+
+
+// el vector se queda también con el asignador de w, que es quien tendrá que
+// liberar el buffer
+template<class T, class Alloc, class Bounds>
+vector_t<T, Alloc, Bounds>&
+vector_t<T, Alloc, Bounds>::operator=(vector_t<T, Alloc, Bounds>&& w) noexcept
+{
+  if (this != &w) {
+    destroy();
+    alloc_ = w.alloc_;
+    v_ = w.v_;
+    sz_ = w.sz_;
+    cap_ = w.cap_;
+    w.v_ = NULL;
+    w.sz_ = 0;
+    w.cap_ = 0;
+  }
+  return *this;
+}
+
+
+
+template<class T, class Alloc, class Bounds>
+template<class E>
+vector_t<T, Alloc, Bounds>::vector_t(const vector_expr_t<E>& e, const Alloc& alloc) : alloc_(alloc)
+{
+  sz_ = e.self().get_size();
+  build();
+  for (int i = 0; i < sz_; ++i)
+    v_[i] = e.self()[i];
+}
+
+
+
+// La expresión se evalúa directamente sobre este vector salvo que lo lea de
+// forma que eso la estropee (p. ej. x = A * x) o que haya que cambiarle el
+// tamaño mientras lo lee; en esos casos se pasa por un temporal.
+template<class T, class Alloc, class Bounds>
+template<class E>
+vector_t<T, Alloc, Bounds>&
+vector_t<T, Alloc, Bounds>::operator=(const vector_expr_t<E>& e)
+{
+  const E& expr = e.self();
+  if (expr.needs_temp(this) || (expr.get_size() != sz_ && expr.reads(this))) {
+    vector_t<T, Alloc, Bounds> tmp(expr, alloc_);
+    return *this = move(tmp);
+  }
+  if (expr.get_size() != sz_)
+    resize(expr.get_size());
+  for (int i = 0; i < sz_; ++i)
+    v_[i] = expr[i];
+  return *this;
+}
+
+
+
+// Los elementos de un T trivial (double, int...) no se inicializan: se van a
+// sobrescribir con read(), set_val() o una expresión. Los demás se construyen
+// por defecto, los cap_ que hay en el buffer.
+template<class T, class Alloc, class Bounds>
 void
-vector_t<T>::build()
+vector_t<T, Alloc, Bounds>::build()
 {
   v_ = NULL;
+  cap_ = sz_;
   if (sz_ != 0) {
-    v_ = new T[sz_];
+    v_ = allocator_traits<Alloc>::allocate(alloc_, sz_);
     assert(v_ != NULL);
+    if constexpr (!is_trivially_default_constructible<T>::value) {
+      try {
+        uninitialized_default_construct_n(v_, sz_);
+      } catch (...) {
+        allocator_traits<Alloc>::deallocate(alloc_, v_, sz_);
+        v_ = NULL;
+        sz_ = cap_ = 0;
+        throw;
+      }
+    }
   }
 }
 
 
 
-template<class T>
+template<class T, class Alloc, class Bounds>
 void
-vector_t<T>::destroy()
+vector_t<T, Alloc, Bounds>::destroy()
 {
   if (v_ != NULL) {
-    delete[] v_;
+    if constexpr (!is_trivially_destructible<T>::value)
+      std::destroy_n(v_, cap_);
+    allocator_traits<Alloc>::deallocate(alloc_, v_, cap_);
     v_ = NULL;
   }
   sz_ = 0;
+  cap_ = 0;
 }
 
 
 
-template<class T>
+// Si el buffer actual tiene sitio se reutiliza y solo cambia el tamaño; si
+// no, se reserva uno nuevo. En ambos casos el contenido no se conserva.
+template<class T, class Alloc, class Bounds>
 void
-vector_t<T>::resize(const int n)
+vector_t<T, Alloc, Bounds>::resize(const int n)
 {
+  if (n <= cap_) {
+    sz_ = n;
+    return;
+  }
   destroy();
   sz_ = n;
   build();
@@ -105,88 +257,133 @@ vector_t<T>::resize(const int n)
 
 
 
-template<class T>
+template<class T, class Alloc, class Bounds>
 inline T
-vector_t<T>::get_val(const int i) const
+vector_t<T, Alloc, Bounds>::get_val(const int i) const
 {
-  assert(i >= 0 && i < get_size());
+  Bounds::check(i >= 0 && i < get_size());
   return v_[i];
 }
 
 
 
-template<class T>
+template<class T, class Alloc, class Bounds>
 inline int
-vector_t<T>::get_size() const
+vector_t<T, Alloc, Bounds>::get_size() const
 {
   return sz_;
 }
 
 
 
-template<class T>
+template<class T, class Alloc, class Bounds>
 void
-vector_t<T>::set_val(const int i, const T d)
+vector_t<T, Alloc, Bounds>::set_val(const int i, const T d)
 {
-  assert(i >= 0 && i < get_size());
+  Bounds::check(i >= 0 && i < get_size());
   v_[i] = d;
 }
 
 
 
-template<class T>
+template<class T, class Alloc, class Bounds>
 T&
-vector_t<T>::at(const int i)
+vector_t<T, Alloc, Bounds>::at(const int i)
 {
-  assert(i >= 0 && i < get_size());
+  Bounds::check(i >= 0 && i < get_size());
   return v_[i];
 }
 
 
 
-template<class T>
+template<class T, class Alloc, class Bounds>
 T&
-vector_t<T>::operator[](const int i)
+vector_t<T, Alloc, Bounds>::operator[](const int i)
 {
   return at(i);
 }
 
 
 
-template<class T>
+template<class T, class Alloc, class Bounds>
 const T&
-vector_t<T>::at(const int i) const
+vector_t<T, Alloc, Bounds>::at(const int i) const
 {
-  assert(i >= 0 && i < get_size());
+  Bounds::check(i >= 0 && i < get_size());
   return v_[i];
 }
 
 
 
-template<class T>
+template<class T, class Alloc, class Bounds>
 const T&
-vector_t<T>::operator[](const int i) const
+vector_t<T, Alloc, Bounds>::operator[](const int i) const
 {
   return at(i);
 }
 
 
 
-template<class T>
+template<class T, class Alloc, class Bounds>
+inline T*
+vector_t<T, Alloc, Bounds>::data(void)
+{
+  return v_;
+}
+
+
+
+template<class T, class Alloc, class Bounds>
+inline const T*
+vector_t<T, Alloc, Bounds>::data(void) const
+{
+  return v_;
+}
+
+
+
+template<class T, class Alloc, class Bounds>
+inline raw_span_t<T>
+vector_t<T, Alloc, Bounds>::span(void)
+{
+  return raw_span_t<T>(v_, sz_);
+}
+
+
+
+template<class T, class Alloc, class Bounds>
+inline raw_span_t<const T>
+vector_t<T, Alloc, Bounds>::span(void) const
+{
+  return raw_span_t<const T>(v_, sz_);
+}
+
+
+
+template<class T, class Alloc, class Bounds>
+inline Alloc
+vector_t<T, Alloc, Bounds>::get_allocator(void) const
+{
+  return alloc_;
+}
+
+
+
+template<class T, class Alloc, class Bounds>
 void
-vector_t<T>::write(ostream& os) const
+vector_t<T, Alloc, Bounds>::write(ostream& os) const
 { 
   os << get_size() << ":\t";
   for (int i = 0; i < get_size(); i++)
     os << at(i) << "\t";
-  os << endl;
+  os << '\n';
 }
 
 
 
-template<class T>
+template<class T, class Alloc, class Bounds>
 void
-vector_t<T>::read(istream& is)
+vector_t<T, Alloc, Bounds>::read(istream& is)
 {
   is >> sz_;
   resize(sz_);
@@ -196,9 +393,9 @@ vector_t<T>::read(istream& is)
 
 
 // FASE II: producto escalar
-template<class T>
+template<class T, class Alloc, class Bounds>
 T
-scal_prod(const vector_t<T>& v, const vector_t<T>& w)
+scal_prod(const vector_t<T, Alloc, Bounds>& v, const vector_t<T, Alloc, Bounds>& w)
 { 
   T producto_escalar = T(0);
   for(int i = 0;i < v.get_size(); i++) {
@@ -209,6 +406,27 @@ scal_prod(const vector_t<T>& v, const vector_t<T>& w)
 
 
 
+// Para double y float el producto escalar se hace con los núcleos de simd.hpp
+template<class Alloc, class Bounds>
+inline double
+scal_prod(const vector_t<double, Alloc, Bounds>& v, const vector_t<double, Alloc, Bounds>& w)
+{
+  assert(v.get_size() == w.get_size());
+  return simd_dot(v.data(), w.data(), v.get_size());
+}
+
+
+
+template<class Alloc, class Bounds>
+inline float
+scal_prod(const vector_t<float, Alloc, Bounds>& v, const vector_t<float, Alloc, Bounds>& w)
+{
+  assert(v.get_size() == w.get_size());
+  return simd_dot(v.data(), w.data(), v.get_size());
+}
+
+
+
 double
 scal_prod(const vector_t<rational_t>& v, const vector_t<rational_t>& w)
 {
@@ -12,10 +12,16 @@
 #define POLYNOMIAL_H_
 
 #include <iostream>
-#include <math.h>  // fabs, pow
+#include <cassert>
+#include <math.h>  // fabs
 
 #include "vector_t.h"
 #include "sparse_vector_t.h"
+#include "sparse_simd.h"
+
+// Desde este número de coeficientes Polynomial::Eval usa Estrin en lugar de
+// Horner
+const int kEstrinMinSize = 8;
 
 // Clase para polinomios basados en vectores densos de doubles
 class Polynomial : public vector_t<double> {
@@ -24,6 +30,12 @@ class Polynomial : public vector_t<double> {
   Polynomial(const int n = 0) : vector_t<double>(n) {};
   Polynomial(const Polynomial& pol)
       : vector_t<double>(pol) {}; // constructor de copia
+  Polynomial(Polynomial&& pol) noexcept
+      : vector_t<double>(std::move(pol)) {}; // constructor de movimiento
+
+  // operadores de asignación
+  Polynomial& operator=(const Polynomial&) = default;
+  Polynomial& operator=(Polynomial&&) = default;
 
   // destructor
   ~Polynomial() {};
@@ -33,6 +45,8 @@ class Polynomial : public vector_t<double> {
   
   // operaciones
   double Eval(const double) const;
+  // out[j] = p(xs[j]) para todos los puntos a la vez; out puede ser xs
+  void Eval(const vector_t<double>&, vector_t<double>&) const;
   bool IsEqual(const Polynomial&, const double = EPS) const;
  };
 
@@ -44,6 +58,12 @@ class SparsePolynomial : public sparse_vector_t {
   SparsePolynomial(const int n = 0) : sparse_vector_t(n) {};
   SparsePolynomial(const Polynomial& pol) : sparse_vector_t(pol) {};
   SparsePolynomial(const SparsePolynomial&);  // constructor de copia
+  SparsePolynomial(SparsePolynomial&& spol) noexcept
+      : sparse_vector_t(std::move(spol)) {};  // constructor de movimiento
+
+  // operadores de asignación
+  SparsePolynomial& operator=(const SparsePolynomial&) = default;
+  SparsePolynomial& operator=(SparsePolynomial&&) = default;
 
   // destructor
   ~SparsePolynomial() {};
@@ -80,13 +100,56 @@ std::ostream& operator<<(std::ostream& os, const Polynomial& p) {
 
 // Operaciones con polinomios
 
-// Evaluación de un polinomio representado por vector denso
+// x^e (e >= 0) por cuadrados sucesivos: O(log e) productos y sin pow
+inline double IntPow(double x, int e) {
+  assert(e >= 0);
+  double result{1.0};
+  while (e > 0) {
+    if (e & 1)
+      result *= x;
+    x *= x;
+    e >>= 1;
+  }
+  return result;
+}
+
+// Evaluación de un polinomio representado por vector denso, sin pow. Los
+// polinomios cortos van por Horner; los largos por Estrin de dos niveles: con
+// y = x^4, p(x) = (P0(y) + x P1(y)) + x^2 (P2(y) + x P3(y)), donde Pr tiene
+// los coeficientes de grado 4k + r, y las cuatro cadenas de Horner en y son
+// independientes, así que sus operaciones se solapan.
 double Polynomial::Eval(const double x) const {
-  double result{0.0};
-  for (int i = 0; i < get_size(); i++)
-    result += at(i) * pow(x, i);
+  const double* c = data();
+  const int n = get_size();
+  if (n < kEstrinMinSize) {
+    double result{0.0};
+    for (int i = n - 1; i >= 0; i--)
+      result = result * x + c[i];
+    return result;
+  }
 
-  return result;
+  const double x2 = x * x;
+  const double y = x2 * x2;
+  const int top = (n - 1) / 4 * 4;  // el último grupo puede estar incompleto
+  double p0 = c[top];
+  double p1 = (top + 1 < n) ? c[top + 1] : 0.0;
+  double p2 = (top + 2 < n) ? c[top + 2] : 0.0;
+  double p3 = (top + 3 < n) ? c[top + 3] : 0.0;
+  for (int b = top - 4; b >= 0; b -= 4) {
+    p0 = p0 * y + c[b];
+    p1 = p1 * y + c[b + 1];
+    p2 = p2 * y + c[b + 2];
+    p3 = p3 * y + c[b + 3];
+  }
+  return (p0 + x * p1) + x2 * (p2 + x * p3);
+}
+
+// Evaluación en muchos puntos: Horner con un punto por carril vectorial
+// (HornerBatch). Puede diferir de Eval(x) en los últimos bits, porque el
+// orden de las operaciones no es el mismo.
+void Polynomial::Eval(const vector_t<double>& xs, vector_t<double>& out) const {
+  out.resize(xs.get_size());
+  HornerBatch(data(), get_size(), xs.data(), xs.get_size(), out.data());
 }
 
 // Comparación si son iguales dos polinomios representados por vectores densos
@@ -131,52 +194,58 @@ std::ostream& operator<<(std::ostream& os, const SparsePolynomial& p) {
 
 // Operaciones con polinomios
 
-// Evaluación de un polinomio representado por vector disperso
+// Evaluación de un polinomio representado por vector disperso: Horner sobre
+// los no nulos, multiplicando en cada paso por x elevado al salto de grado
+// hasta el siguiente, p(x) = x^e0 (c0 + x^(e1 - e0) (c1 + ...)).
 double SparsePolynomial::Eval(const double x) const {
-  double result{0.0};
-  for (int i = 0; i < get_nz(); i++)
-    result += at(i).get_val() * pow(x, at(i).get_inx());
-
-  return result;
+  const int* inx = inx_data();
+  const double* val = val_data();
+  if (get_nz() == 0)
+    return 0.0;
+
+  double result{val[get_nz() - 1]};
+  for (int k = get_nz() - 2; k >= 0; k--)
+    result = result * IntPow(x, inx[k + 1] - inx[k]) + val[k];
+  return result * IntPow(x, inx[0]);
 }
 
 // Comparación si son iguales dos polinomios representados por vectores dispersos
 bool SparsePolynomial::IsEqual(const SparsePolynomial& spol
 			       , const double eps) const {
+  // mezcla sobre los arrays de índices y valores, sin pasar por at()
+  const int* inx_a = inx_data();
+  const double* val_a = val_data();
+  const int* inx_b = spol.inx_data();
+  const double* val_b = spol.val_data();
+  const int nz_a = get_nz();
+  const int nz_b = spol.get_nz();
   int i = 0;
   int j = 0;
 
-  while (i < get_nz() && j < spol.get_nz()) {
-    int inx_i = at(i).get_inx();
-    int inx_j = spol.at(j).get_inx();
-
-    if (inx_i == inx_j) {
-      if (fabs(at(i).get_val() - spol.at(j).get_val()) > eps)
+  while (i < nz_a && j < nz_b) {
+    if (inx_a[i] == inx_b[j]) {
+      if (fabs(val_a[i] - val_b[j]) > eps)
         return false;
       i++;
       j++;
-    } else if (inx_i < inx_j) {
-      if (IsNotZero(at(i).get_val(), eps))
+    } else if (inx_a[i] < inx_b[j]) {
+      if (IsNotZero(val_a[i], eps))
         return false;
       i++;
     } else {
-      if (IsNotZero(spol.at(j).get_val(), eps))
+      if (IsNotZero(val_b[j], eps))
         return false;
       j++;
     }
   }
 
-  while (i < get_nz()) {
-    if (IsNotZero(at(i).get_val(), eps))
+  for (; i < nz_a; i++)
+    if (IsNotZero(val_a[i], eps))
       return false;
-    i++;
-  }
 
-  while (j < spol.get_nz()) {
-    if (IsNotZero(spol.at(j).get_val(), eps))
+  for (; j < nz_b; j++)
+    if (IsNotZero(val_b[j], eps))
       return false;
-    j++;
-  }
 
   return true;
 }
@@ -184,24 +253,25 @@ bool SparsePolynomial::IsEqual(const SparsePolynomial& spol
 // Comparación si son iguales dos polinomios representados por
 // vector disperso y vector denso
 bool SparsePolynomial::IsEqual(const Polynomial& pol, const double eps) const {
+  const int* inx = inx_data();
+  const double* val = val_data();
+  const int nz = get_nz();
   int i = 0;
 
-  for (int inx = 0; inx < pol.get_size(); inx++) {
+  for (int k = 0; k < pol.get_size(); k++) {
     double sparse_val = 0.0;
-    if (i < get_nz() && at(i).get_inx() == inx) {
-      sparse_val = at(i).get_val();
+    if (i < nz && inx[i] == k) {
+      sparse_val = val[i];
       i++;
     }
 
-    if (fabs(sparse_val - pol.at(inx)) > eps)
+    if (fabs(sparse_val - pol.at(k)) > eps)
       return false;
   }
 
-  while (i < get_nz()) {
-    if (IsNotZero(at(i).get_val(), eps))
+  for (; i < nz; i++)
+    if (IsNotZero(val[i], eps))
       return false;
-    i++;
-  }
 
   return true;
 }
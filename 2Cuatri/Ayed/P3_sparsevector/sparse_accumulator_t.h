@@ -0,0 +1,212 @@
+// AUTOR: Kin Daniel Fortuno Pontillas
+// FECHA: 18 de marzo de 2026
+// EMAIL: alu0101679112@ull.edu.es
+// VERSION: 1.0
+// ASIGNATURA: Algoritmos y Estructuras de Datos
+// PRÁCTICA Nº: 3
+// ESTILO: Google C++ Style Guide
+// COMENTARIOS: acumulador disperso modificable. sparse_vector_t no se puede
+// cambiar una vez construido; aquí se van sumando valores en posiciones
+// cualesquiera (Add, Axpy) en O(1) cada uno y al final Freeze() lo convierte
+// en un sparse_vector_t ordenado en O(nz log nz). La memoria es
+// proporcional a los no nulos, nunca al tamaño n del vector.
+// Por dentro es una tabla hash de direccionamiento abierto: claves (índices)
+// y valores en dos arrays, repartidas en grupos de kProbeGroup huecos. Un
+// índice va al grupo que da su hash y, si está lleno, al siguiente; cada
+// grupo se compara entero de una vez (ProbeGroup, sparse_simd.h). Nunca se
+// borran claves, así que el primer grupo con un hueco libre termina la
+// búsqueda.
+//
+
+#ifndef SPARSE_ACCUMULATORT_H_
+#define SPARSE_ACCUMULATORT_H_
+
+#include <iostream>
+#include <cassert>
+#include <algorithm>
+#include <stdint.h>
+
+#include "vector_t.h"
+#include "sparse_vector_t.h"
+#include "sparse_simd.h"
+
+// clave de los huecos libres (los índices empiezan en 0)
+const int kEmptySlot = -1;
+// grupos mínimos de la tabla
+const int kMinGroups = 2;
+
+class sparse_accumulator_t {
+ public:
+  // constructores: vector de tamaño n a cero, con sitio para nz no nulos
+  // antes de tener que crecer
+  sparse_accumulator_t(const int = 0, const int = 0);
+
+  // getters
+  int get_n(void) const;
+  int get_nz(void) const;  // posiciones guardadas (pueden valer 0)
+
+  // valor de la posición i, 0 si no está guardada
+  double get_val(const int) const;
+
+  // operaciones
+  void Set(const int, const double);  // x[i] = v
+  void Add(const int, const double);  // x[i] += v
+  void Axpy(const double, const sparse_vector_t&);  // x += a w
+  void Clear(void);  // todo a cero, conservando la tabla
+
+  // v = x, ordenado y sin los valores que no superan eps
+  void Freeze(sparse_vector_t&, const double = EPS) const;
+
+ private:
+  vector_t<int> keys_;     // índice guardado en cada hueco o kEmptySlot
+  vector_t<double> vals_;  // valor de cada hueco
+  int groups_;             // grupos de kProbeGroup huecos, potencia de 2
+  int shift_;              // 32 - log2(groups_), para el hash
+  int nz_;                 // huecos ocupados
+  int n_;                  // tamaño del vector
+
+  int Group(const int) const;
+  int Find(const int) const;
+  int Insert(const int);
+  void Rehash(const int);
+};
+
+sparse_accumulator_t::sparse_accumulator_t(const int n, const int nz)
+    : keys_(), vals_(), groups_(0), shift_(0), nz_(0), n_(n) {
+  int groups = kMinGroups;
+  while (groups * kProbeGroup * 3 < nz * 4)
+    groups *= 2;
+  Rehash(groups);
+}
+
+inline int sparse_accumulator_t::get_n() const {
+  return n_;
+}
+
+inline int sparse_accumulator_t::get_nz() const {
+  return nz_;
+}
+
+// Hash multiplicativo (Fibonacci): los bits altos del producto eligen el
+// grupo, así que índices consecutivos caen en grupos separados
+inline int sparse_accumulator_t::Group(const int i) const {
+  return int((static_cast<uint32_t>(i) * 2654435769u) >> shift_);
+}
+
+// Hueco del índice i, o -1 si no está
+int sparse_accumulator_t::Find(const int i) const {
+  const int* keys = keys_.data();
+  for (int g = Group(i);; g = (g + 1) & (groups_ - 1)) {
+    const int m = ProbeGroup(keys + g * kProbeGroup, i, kEmptySlot);
+    if (m & ((1 << kProbeGroup) - 1))
+      return g * kProbeGroup + __builtin_ctz(m);
+    if (m != 0)
+      return -1;
+  }
+}
+
+// Hueco del índice i, que se añade con valor 0 si no estaba. La tabla se
+// dobla antes de pasar de 3/4 de ocupación.
+int sparse_accumulator_t::Insert(const int i) {
+  assert(i >= 0 && i < get_n());
+  if ((nz_ + 1) * 4 > groups_ * kProbeGroup * 3)
+    Rehash(2 * groups_);
+  int* keys = keys_.data();
+  for (int g = Group(i);; g = (g + 1) & (groups_ - 1)) {
+    const int m = ProbeGroup(keys + g * kProbeGroup, i, kEmptySlot);
+    if (m & ((1 << kProbeGroup) - 1))
+      return g * kProbeGroup + __builtin_ctz(m);
+    if (m != 0) {
+      const int slot = g * kProbeGroup + __builtin_ctz(m >> kProbeGroup);
+      keys[slot] = i;
+      vals_[slot] = 0.0;
+      nz_++;
+      return slot;
+    }
+  }
+}
+
+// Pasa a una tabla de groups grupos y vuelve a colocar lo que había
+void sparse_accumulator_t::Rehash(const int groups) {
+  vector_t<int> keys(std::move(keys_));
+  vector_t<double> vals(std::move(vals_));
+  const int old_slots = groups_ * kProbeGroup;
+
+  groups_ = groups;
+  shift_ = 32 - __builtin_ctz(groups_);
+  keys_.resize(groups_ * kProbeGroup);
+  vals_.resize(groups_ * kProbeGroup);
+  std::fill(keys_.data(), keys_.data() + keys_.get_size(), kEmptySlot);
+
+  for (int s = 0; s < old_slots; s++) {
+    if (keys[s] == kEmptySlot)
+      continue;
+    for (int g = Group(keys[s]);; g = (g + 1) & (groups_ - 1)) {
+      const int m = ProbeGroup(keys_.data() + g * kProbeGroup, kEmptySlot,
+                               kEmptySlot);
+      if (m != 0) {
+        const int slot = g * kProbeGroup + __builtin_ctz(m);
+        keys_[slot] = keys[s];
+        vals_[slot] = vals[s];
+        break;
+      }
+    }
+  }
+}
+
+double sparse_accumulator_t::get_val(const int i) const {
+  assert(i >= 0 && i < get_n());
+  const int slot = Find(i);
+  return slot < 0 ? 0.0 : vals_[slot];
+}
+
+void sparse_accumulator_t::Set(const int i, const double v) {
+  vals_[Insert(i)] = v;
+}
+
+void sparse_accumulator_t::Add(const int i, const double v) {
+  vals_[Insert(i)] += v;
+}
+
+void sparse_accumulator_t::Axpy(const double a, const sparse_vector_t& w) {
+  assert(w.get_n() == get_n());
+  const int* wi = w.inx_data();
+  const double* wv = w.val_data();
+  for (int k = 0; k < w.get_nz(); k++)
+    Add(wi[k], a * wv[k]);
+}
+
+void sparse_accumulator_t::Clear(void) {
+  std::fill(keys_.data(), keys_.data() + keys_.get_size(), kEmptySlot);
+  nz_ = 0;
+}
+
+// Se copian y ordenan solo los índices; el valor de cada uno se vuelve a
+// buscar en la tabla, que es O(1), en lugar de ordenar pares (índice, valor).
+void sparse_accumulator_t::Freeze(sparse_vector_t& v,
+                                  const double eps) const {
+  v.n_ = get_n();
+  v.inx_.resize(get_nz());
+  v.val_.resize(get_nz());
+  int* vi = v.inx_.data();
+  double* vv = v.val_.data();
+
+  int k = 0;
+  for (int s = 0; s < keys_.get_size(); s++)
+    if (keys_[s] != kEmptySlot)
+      vi[k++] = keys_[s];
+  std::sort(vi, vi + k);
+
+  int nz = 0;
+  for (int j = 0; j < k; j++) {
+    const double val = vals_[Find(vi[j])];
+    vi[nz] = vi[j];
+    vv[nz] = val;
+    nz += IsNotZero(val, eps);
+  }
+  v.nz_ = nz;
+  v.inx_.resize(nz);
+  v.val_.resize(nz);
+}
+
+#endif  // SPARSE_ACCUMULATORT_H_
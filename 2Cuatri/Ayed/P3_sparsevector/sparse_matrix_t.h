@@ -0,0 +1,357 @@
+// AUTOR: Kin Daniel Fortuno Pontillas
+// FECHA: 18 de marzo de 2026
+// EMAIL: alu0101679112@ull.edu.es
+// VERSION: 1.0
+// ASIGNATURA: Algoritmos y Estructuras de Datos
+// PRÁCTICA Nº: 3
+// ESTILO: Google C++ Style Guide
+// COMENTARIOS: matriz dispersa en formato CSR (compressed sparse row): los
+// valores no nulos por filas en val_, su columna en col_, y en row_ptr_ dónde
+// empieza cada fila (la fila i ocupa [row_ptr_[i], row_ptr_[i + 1])). Dentro
+// de una fila las columnas van en orden creciente, como los índices de
+// sparse_vector_t. El formato CSC de A es el CSR de su traspuesta, que da
+// Transpose().
+// Índices desde 0.
+//
+
+#ifndef SPARSE_MATRIXT_H_
+#define SPARSE_MATRIXT_H_
+
+#include <iostream>
+#include <cassert>
+#include <algorithm>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "vector_t.h"
+#include "sparse_vector_t.h"
+
+// Por debajo de este número de no nulos por hilo el producto por un vector
+// no compensa el coste de lanzar hilos.
+const int kSpmvMinNzPerThread = 1 << 15;
+
+class sparse_matrix_t {
+ public:
+  // constructores
+  sparse_matrix_t(const int = 0, const int = 0);  // m x n sin no nulos
+  sparse_matrix_t(const int, const int, const vector_t<double>&,
+                  const double = EPS);  // desde una densa de m x n por filas
+  template<class Matrix>
+  explicit sparse_matrix_t(const Matrix&, const double = EPS);  // desde un matrix_t
+  sparse_matrix_t(const sparse_matrix_t&) = default;  // constructor de copia
+  sparse_matrix_t(sparse_matrix_t&&) noexcept;  // constructor de movimiento
+
+  // operadores de asignación
+  sparse_matrix_t& operator=(const sparse_matrix_t&) = default;
+  sparse_matrix_t& operator=(sparse_matrix_t&&) noexcept;
+
+  // destructor
+  ~sparse_matrix_t() {}
+
+  // getters
+  int get_m(void) const;
+  int get_n(void) const;
+  int get_nz(void) const;
+
+  // elemento (i, j), 0 si no está guardado; búsqueda binaria en la fila i
+  double get_val(const int, const int) const;
+
+  // operaciones
+  // y = A x, repartiendo las filas entre hilos (0 = un hilo por CPU)
+  void Multiply(const vector_t<double>&, vector_t<double>&,
+                int num_threads = 0) const;
+  // A B con el algoritmo de Gustavson
+  sparse_matrix_t Multiply(const sparse_matrix_t&) const;
+  sparse_matrix_t Transpose(void) const;
+
+  // E/S
+  void write(std::ostream& = std::cout) const;
+
+ private:
+  int m_, n_;
+  vector_t<int> row_ptr_;  // m_ + 1 posiciones
+  vector_t<int> col_;      // columna de cada no nulo
+  vector_t<double> val_;   // valor de cada no nulo
+
+  void MultiplyRows(const int, const int, const double*, double*) const;
+  void ResetRowPtr(void);
+};
+
+sparse_matrix_t::sparse_matrix_t(const int m, const int n)
+    : m_(m), n_(n), row_ptr_(m + 1), col_(), val_() {
+  for (int i = 0; i <= m_; i++)
+    row_ptr_[i] = 0;
+}
+
+// FASE II: construcción desde una matriz densa, como en sparse_vector_t, con
+// una pasada para contar los no nulos y otra para copiarlos
+sparse_matrix_t::sparse_matrix_t(const int m, const int n,
+                                 const vector_t<double>& dense,
+                                 const double eps)
+    : m_(m), n_(n), row_ptr_(m + 1), col_(), val_() {
+  assert(dense.get_size() == m * n);
+  const double* a = dense.data();
+  int nz = 0;
+  for (int k = 0; k < m * n; k++)
+    if (IsNotZero(a[k], eps))
+      nz++;
+
+  col_.resize(nz);
+  val_.resize(nz);
+  nz = 0;
+  for (int i = 0; i < m_; i++) {
+    row_ptr_[i] = nz;
+    for (int j = 0; j < n_; j++)
+      if (IsNotZero(a[i * n_ + j], eps)) {
+        col_[nz] = j;
+        val_[nz] = a[i * n_ + j];
+        nz++;
+      }
+  }
+  row_ptr_[m_] = nz;
+}
+
+// Matrix es cualquier matriz densa con get_m(), get_n() y at(i, j) desde 1,
+// como matrix_t
+template<class Matrix>
+sparse_matrix_t::sparse_matrix_t(const Matrix& A, const double eps)
+    : m_(A.get_m()), n_(A.get_n()), row_ptr_(A.get_m() + 1), col_(), val_() {
+  int nz = 0;
+  for (int i = 1; i <= m_; i++)
+    for (int j = 1; j <= n_; j++)
+      if (IsNotZero(A.at(i, j), eps))
+        nz++;
+
+  col_.resize(nz);
+  val_.resize(nz);
+  nz = 0;
+  for (int i = 1; i <= m_; i++) {
+    row_ptr_[i - 1] = nz;
+    for (int j = 1; j <= n_; j++)
+      if (IsNotZero(A.at(i, j), eps)) {
+        col_[nz] = j - 1;
+        val_[nz] = A.at(i, j);
+        nz++;
+      }
+  }
+  row_ptr_[m_] = nz;
+}
+
+// constructor de movimiento
+sparse_matrix_t::sparse_matrix_t(sparse_matrix_t&& A) noexcept
+    : m_(A.m_), n_(A.n_), row_ptr_(std::move(A.row_ptr_)),
+      col_(std::move(A.col_)), val_(std::move(A.val_)) {
+  A.m_ = 0;
+  A.n_ = 0;
+  A.ResetRowPtr();
+}
+
+// operador de asignación por movimiento
+sparse_matrix_t& sparse_matrix_t::operator=(sparse_matrix_t&& A) noexcept {
+  if (this != &A) {
+    m_ = A.m_;
+    n_ = A.n_;
+    row_ptr_ = std::move(A.row_ptr_);
+    col_ = std::move(A.col_);
+    val_ = std::move(A.val_);
+    A.m_ = 0;
+    A.n_ = 0;
+    A.ResetRowPtr();
+  }
+
+  return *this;
+}
+
+// Deja la matriz movida como una de 0 x 0 válida: row_ptr_ con m_ + 1 = 1
+// posiciones
+inline void sparse_matrix_t::ResetRowPtr(void) {
+  row_ptr_.resize(1);
+  row_ptr_[0] = 0;
+}
+
+inline int sparse_matrix_t::get_m() const {
+  return m_;
+}
+
+inline int sparse_matrix_t::get_n() const {
+  return n_;
+}
+
+inline int sparse_matrix_t::get_nz() const {
+  return val_.get_size();
+}
+
+double sparse_matrix_t::get_val(const int i, const int j) const {
+  assert(i >= 0 && i < get_m() && j >= 0 && j < get_n());
+  const int* begin = col_.data() + row_ptr_[i];
+  const int* end = col_.data() + row_ptr_[i + 1];
+  const int* p = std::lower_bound(begin, end, j);
+  return (p != end && *p == j) ? val_[p - col_.data()] : 0.0;
+}
+
+// y[i] = fila i de A por x, para las filas [first, last)
+void sparse_matrix_t::MultiplyRows(const int first, const int last,
+                                   const double* x, double* y) const {
+  const int* row_ptr = row_ptr_.data();
+  const int* col = col_.data();
+  const double* val = val_.data();
+  for (int i = first; i < last; i++) {
+    double sum = 0.0;
+    for (int k = row_ptr[i]; k < row_ptr[i + 1]; k++)
+      sum += val[k] * x[col[k]];
+    y[i] = sum;
+  }
+}
+
+// FASE III: producto por un vector denso. Cada hilo se lleva un tramo de
+// filas con aproximadamente el mismo número de no nulos (no el mismo número
+// de filas), buscado en row_ptr_. Cada y[i] lo calcula un solo hilo y en el
+// mismo orden, así que el resultado no depende del número de hilos.
+void sparse_matrix_t::Multiply(const vector_t<double>& x, vector_t<double>& y,
+                               int num_threads) const {
+  assert(x.get_size() == get_n());
+  assert(&x != &y);
+  y.resize(get_m());
+
+  if (num_threads <= 0)
+    num_threads = std::max(1, int(std::thread::hardware_concurrency()));
+  num_threads = std::min(num_threads,
+                         std::max(1, get_nz() / kSpmvMinNzPerThread));
+  if (num_threads == 1 || get_m() == 0) {
+    MultiplyRows(0, get_m(), x.data(), y.data());
+    return;
+  }
+
+  const int* row_ptr = row_ptr_.data();
+  std::vector<int> first_row(num_threads + 1);
+  first_row[0] = 0;
+  first_row[num_threads] = get_m();
+  for (int t = 1; t < num_threads; t++) {
+    const int target = int(static_cast<long long>(get_nz()) * t / num_threads);
+    first_row[t] = int(std::lower_bound(row_ptr, row_ptr + get_m(), target) -
+                       row_ptr);
+    first_row[t] = std::max(first_row[t], first_row[t - 1]);
+  }
+
+  std::vector<std::thread> threads;
+  for (int t = 1; t < num_threads; t++)
+    threads.emplace_back(&sparse_matrix_t::MultiplyRows, this, first_row[t],
+                         first_row[t + 1], x.data(), y.data());
+  MultiplyRows(first_row[0], first_row[1], x.data(), y.data());
+  for (std::thread& t : threads)
+    t.join();
+}
+
+// Producto de dos matrices dispersas (Gustavson): la fila i de C es la suma
+// de las filas k de B escaladas por A(i, k). Se acumula en un vector denso de
+// n columnas con una marca por columna para saber cuáles ya se han tocado en
+// esta fila, así que el coste es proporcional al número de productos a_ik b_kj
+// más los no nulos de C (más ordenar las columnas de cada fila), nunca a m n.
+// Se hace en dos pasadas: una cuenta los no nulos de cada fila de C y otra
+// los calcula ya en su sitio.
+sparse_matrix_t sparse_matrix_t::Multiply(const sparse_matrix_t& B) const {
+  assert(get_n() == B.get_m());
+  const int m = get_m();
+  const int n = B.get_n();
+  sparse_matrix_t C(m, n);
+
+  const int* a_ptr = row_ptr_.data();
+  const int* a_col = col_.data();
+  const double* a_val = val_.data();
+  const int* b_ptr = B.row_ptr_.data();
+  const int* b_col = B.col_.data();
+  const double* b_val = B.val_.data();
+
+  // marca de cada columna: última fila de C que la ha tocado
+  std::vector<int> mark(n, -1);
+
+  // pasada simbólica
+  int* c_ptr = C.row_ptr_.data();
+  c_ptr[0] = 0;
+  for (int i = 0; i < m; i++) {
+    int count = 0;
+    for (int ka = a_ptr[i]; ka < a_ptr[i + 1]; ka++) {
+      const int k = a_col[ka];
+      for (int kb = b_ptr[k]; kb < b_ptr[k + 1]; kb++)
+        if (mark[b_col[kb]] != i) {
+          mark[b_col[kb]] = i;
+          count++;
+        }
+    }
+    c_ptr[i + 1] = c_ptr[i] + count;
+  }
+
+  // pasada numérica
+  C.col_.resize(c_ptr[m]);
+  C.val_.resize(c_ptr[m]);
+  int* c_col = C.col_.data();
+  double* c_val = C.val_.data();
+  std::vector<double> acc(n, 0.0);
+  std::fill(mark.begin(), mark.end(), -1);
+  for (int i = 0; i < m; i++) {
+    int nz = c_ptr[i];
+    for (int ka = a_ptr[i]; ka < a_ptr[i + 1]; ka++) {
+      const int k = a_col[ka];
+      const double a_ik = a_val[ka];
+      for (int kb = b_ptr[k]; kb < b_ptr[k + 1]; kb++) {
+        const int j = b_col[kb];
+        if (mark[j] != i) {
+          mark[j] = i;
+          c_col[nz++] = j;
+          acc[j] = a_ik * b_val[kb];
+        } else {
+          acc[j] += a_ik * b_val[kb];
+        }
+      }
+    }
+    std::sort(c_col + c_ptr[i], c_col + nz);
+    for (int kc = c_ptr[i]; kc < nz; kc++)
+      c_val[kc] = acc[c_col[kc]];
+  }
+
+  return C;
+}
+
+// Traspuesta en O(nz + m + n): se cuentan los no nulos de cada columna y se
+// reparten en orden de filas, así las columnas de cada fila de la traspuesta
+// salen ya ordenadas.
+sparse_matrix_t sparse_matrix_t::Transpose(void) const {
+  sparse_matrix_t T(get_n(), get_m());
+  T.col_.resize(get_nz());
+  T.val_.resize(get_nz());
+
+  int* t_ptr = T.row_ptr_.data();
+  for (int k = 0; k < get_nz(); k++)
+    t_ptr[col_[k] + 1]++;
+  for (int j = 0; j < get_n(); j++)
+    t_ptr[j + 1] += t_ptr[j];
+
+  std::vector<int> next(t_ptr, t_ptr + get_n());
+  for (int i = 0; i < get_m(); i++)
+    for (int k = row_ptr_[i]; k < row_ptr_[i + 1]; k++) {
+      const int pos = next[col_[k]]++;
+      T.col_[pos] = i;
+      T.val_[pos] = val_[k];
+    }
+
+  return T;
+}
+
+// E/S
+void sparse_matrix_t::write(std::ostream& os) const {
+  os << get_m() << "x" << get_n() << "(" << get_nz() << "):" << std::endl;
+  for (int i = 0; i < get_m(); i++) {
+    os << i << ": [ ";
+    for (int k = row_ptr_[i]; k < row_ptr_[i + 1]; k++)
+      os << pair_double_t(val_[k], col_[k]) << " ";
+    os << "]" << std::endl;
+  }
+}
+
+std::ostream& operator<<(std::ostream& os, const sparse_matrix_t& A) {
+  A.write(os);
+  return os;
+}
+
+#endif  // SPARSE_MATRIXT_H_
@@ -0,0 +1,396 @@
+// AUTOR: Kin Daniel Fortuno Pontillas
+// FECHA: 18 de marzo de 2026
+// EMAIL: alu0101679112@ull.edu.es
+// VERSION: 1.0
+// ASIGNATURA: Algoritmos y Estructuras de Datos
+// PRÁCTICA Nº: 3
+// ESTILO: Google C++ Style Guide
+// COMENTARIOS: núcleos vectoriales (AVX2 y AVX-512) de los vectores
+// dispersos y de los polinomios, elegidos en tiempo de ejecución según la
+// CPU; si no tiene ninguno de los dos, o no es x86, se usa la versión
+// escalar.
+//
+
+#ifndef SPARSE_SIMD_H_
+#define SPARSE_SIMD_H_
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SPARSE_SIMD_X86
+#include <immintrin.h>
+#endif
+#include <math.h>  // fabs
+
+enum SimdLevel { kSimdScalar, kSimdAvx2, kSimdAvx512 };
+
+inline SimdLevel DetectSimdLevel(void) {
+#ifdef SPARSE_SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+    return kSimdAvx512;
+  if (__builtin_cpu_supports("avx2"))
+    return kSimdAvx2;
+#endif
+  return kSimdScalar;
+}
+
+// nivel de la CPU, calculado una sola vez
+inline SimdLevel GetSimdLevel(void) {
+  static const SimdLevel level = DetectSimdLevel();
+  return level;
+}
+
+// Posiciones que las versiones vectoriales de CompressNonZeros pueden pisar
+// detrás de las que devuelven, porque escriben registros enteros
+const int kCompressSlack = 16;
+
+// Número de no nulos de x[0..n), con el criterio de IsNotZero: fabs(x) > eps
+inline int CountNonZerosScalar(const double* x, const int n, const double eps) {
+  int nz = 0;
+  for (int i = 0; i < n; i++)
+    nz += fabs(x[i]) > eps;
+  return nz;
+}
+
+#ifdef SPARSE_SIMD_X86
+__attribute__((target("avx2")))
+inline int CountNonZerosAvx2(const double* x, const int n, const double eps) {
+  const __m256d abs_mask =
+      _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL));
+  const __m256d veps = _mm256_set1_pd(eps);
+  int nz = 0;
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256d x0 = _mm256_and_pd(_mm256_loadu_pd(x + i), abs_mask);
+    const __m256d x1 = _mm256_and_pd(_mm256_loadu_pd(x + i + 4), abs_mask);
+    const int m0 = _mm256_movemask_pd(_mm256_cmp_pd(x0, veps, _CMP_GT_OQ));
+    const int m1 = _mm256_movemask_pd(_mm256_cmp_pd(x1, veps, _CMP_GT_OQ));
+    nz += __builtin_popcount(m0 | (m1 << 4));
+  }
+  return nz + CountNonZerosScalar(x + i, n - i, eps);
+}
+
+__attribute__((target("avx512f")))
+inline int CountNonZerosAvx512(const double* x, const int n,
+                               const double eps) {
+  const __m512d veps = _mm512_set1_pd(eps);
+  int nz = 0;
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const __mmask8 m0 = _mm512_cmp_pd_mask(
+        _mm512_abs_pd(_mm512_loadu_pd(x + i)), veps, _CMP_GT_OQ);
+    const __mmask8 m1 = _mm512_cmp_pd_mask(
+        _mm512_abs_pd(_mm512_loadu_pd(x + i + 8)), veps, _CMP_GT_OQ);
+    nz += __builtin_popcount(m0 | (m1 << 8));
+  }
+  return nz + CountNonZerosScalar(x + i, n - i, eps);
+}
+
+#endif  // SPARSE_SIMD_X86
+
+inline int CountNonZeros(const double* x, const int n, const double eps) {
+  switch (GetSimdLevel()) {
+#ifdef SPARSE_SIMD_X86
+    case kSimdAvx512: return CountNonZerosAvx512(x, n, eps);
+    case kSimdAvx2:   return CountNonZerosAvx2(x, n, eps);
+#endif
+    default:          return CountNonZerosScalar(x, n, eps);
+  }
+}
+
+// Compactación de los no nulos: los elementos de x[0..n) que cumplen
+// fabs(x) > eps se escriben seguidos en val, con su índice base + i en inx.
+// Devuelve cuántos hay. inx y val tienen que tener sitio para ese número más
+// kCompressSlack (o para n, si es menor).
+
+// Sin ramas: se escribe siempre y solo se avanza si el valor no es nulo.
+inline int CompressNonZerosScalar(const double* x, const int n,
+                                  const int base, const double eps,
+                                  int* inx, double* val) {
+  int nz = 0;
+  for (int i = 0; i < n; i++) {
+    inx[nz] = base + i;
+    val[nz] = x[i];
+    nz += fabs(x[i]) > eps;
+  }
+  return nz;
+}
+
+#ifdef SPARSE_SIMD_X86
+// Permutaciones que llevan al principio los carriles activos de una máscara
+// de 4 bits: pd[m] para 4 double (como 8 float) y epi32[m] para 4 int.
+struct CompressTables {
+  int pd[16][8];
+  int epi32[16][4];
+
+  CompressTables(void) : pd(), epi32() {
+    for (int m = 0; m < 16; m++) {
+      int j = 0;
+      for (int k = 0; k < 4; k++) {
+        if ((m >> k) & 1) {
+          pd[m][2 * j] = 2 * k;
+          pd[m][2 * j + 1] = 2 * k + 1;
+          epi32[m][j] = k;
+          j++;
+        }
+      }
+    }
+  }
+};
+
+inline const CompressTables& compress_tables(void) {
+  static const CompressTables tables;
+  return tables;
+}
+
+// AVX2 no tiene compress-store: la máscara de la comparación elige en una
+// tabla la permutación que junta los carriles activos y se guarda el
+// registro entero.
+__attribute__((target("avx2")))
+inline int CompressNonZerosAvx2(const double* x, const int n, const int base,
+                                const double eps, int* inx, double* val) {
+  const CompressTables& tables = compress_tables();
+  const __m256d abs_mask =
+      _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL));
+  const __m256d veps = _mm256_set1_pd(eps);
+  const __m128i four = _mm_set1_epi32(4);
+  __m128i idx = _mm_add_epi32(_mm_set1_epi32(base), _mm_setr_epi32(0, 1, 2, 3));
+  int nz = 0;
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m256d xi = _mm256_loadu_pd(x + i);
+    const int m = _mm256_movemask_pd(
+        _mm256_cmp_pd(_mm256_and_pd(xi, abs_mask), veps, _CMP_GT_OQ));
+    const __m256i p = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(tables.pd[m]));
+    const __m128i q = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(tables.epi32[m]));
+    _mm256_storeu_pd(val + nz, _mm256_castps_pd(_mm256_permutevar8x32_ps(
+                                   _mm256_castpd_ps(xi), p)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(inx + nz),
+                     _mm_castps_si128(_mm_permutevar_ps(
+                         _mm_castsi128_ps(idx), q)));
+    nz += __builtin_popcount(m);
+    idx = _mm_add_epi32(idx, four);
+  }
+  return nz + CompressNonZerosScalar(x + i, n - i, base + i, eps,
+                                     inx + nz, val + nz);
+}
+
+// 16 elementos por vuelta: dos registros de double y uno de 16 índices. La
+// compactación se hace en registro y se guarda el registro entero, que en
+// algunas CPU es bastante más rápido que compress-store sobre memoria.
+__attribute__((target("avx512f")))
+inline int CompressNonZerosAvx512(const double* x, const int n,
+                                  const int base, const double eps,
+                                  int* inx, double* val) {
+  const __m512d veps = _mm512_set1_pd(eps);
+  const __m512i sixteen = _mm512_set1_epi32(16);
+  __m512i idx = _mm512_add_epi32(
+      _mm512_set1_epi32(base),
+      _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7,
+                        8, 9, 10, 11, 12, 13, 14, 15));
+  int nz = 0;
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const __m512d x0 = _mm512_loadu_pd(x + i);
+    const __m512d x1 = _mm512_loadu_pd(x + i + 8);
+    const __mmask8 m0 = _mm512_cmp_pd_mask(_mm512_abs_pd(x0), veps, _CMP_GT_OQ);
+    const __mmask8 m1 = _mm512_cmp_pd_mask(_mm512_abs_pd(x1), veps, _CMP_GT_OQ);
+    const __mmask16 m = static_cast<__mmask16>(m0 | (m1 << 8));
+    const int c0 = __builtin_popcount(m0);
+    _mm512_storeu_si512(inx + nz, _mm512_maskz_compress_epi32(m, idx));
+    _mm512_storeu_pd(val + nz, _mm512_maskz_compress_pd(m0, x0));
+    _mm512_storeu_pd(val + nz + c0, _mm512_maskz_compress_pd(m1, x1));
+    nz += c0 + __builtin_popcount(m1);
+    idx = _mm512_add_epi32(idx, sixteen);
+  }
+  return nz + CompressNonZerosScalar(x + i, n - i, base + i, eps,
+                                     inx + nz, val + nz);
+}
+
+#endif  // SPARSE_SIMD_X86
+
+inline int CompressNonZeros(const double* x, const int n, const int base,
+                            const double eps, int* inx, double* val) {
+  switch (GetSimdLevel()) {
+#ifdef SPARSE_SIMD_X86
+    case kSimdAvx512: return CompressNonZerosAvx512(x, n, base, eps, inx, val);
+    case kSimdAvx2:   return CompressNonZerosAvx2(x, n, base, eps, inx, val);
+#endif
+    default:          return CompressNonZerosScalar(x, n, base, eps, inx, val);
+  }
+}
+
+// Sondeo de una tabla hash por grupos de kProbeGroup claves: los bits 0-7
+// del resultado marcan las claves del grupo iguales a key y los bits 8-15 las
+// iguales a empty (huecos libres).
+const int kProbeGroup = 8;
+
+inline int ProbeGroupScalar(const int* group, const int key,
+                            const int empty) {
+  int m = 0;
+  for (int k = 0; k < kProbeGroup; k++) {
+    m |= (group[k] == key) << k;
+    m |= (group[k] == empty) << (k + kProbeGroup);
+  }
+  return m;
+}
+
+#ifdef SPARSE_SIMD_X86
+// Las 8 claves se comparan de una vez con key y con empty
+__attribute__((target("avx2")))
+inline int ProbeGroupAvx2(const int* group, const int key, const int empty) {
+  const __m256i g =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(group));
+  const int match = _mm256_movemask_ps(
+      _mm256_castsi256_ps(_mm256_cmpeq_epi32(g, _mm256_set1_epi32(key))));
+  const int free = _mm256_movemask_ps(
+      _mm256_castsi256_ps(_mm256_cmpeq_epi32(g, _mm256_set1_epi32(empty))));
+  return match | (free << kProbeGroup);
+}
+#endif  // SPARSE_SIMD_X86
+
+// Con 8 claves por grupo AVX-512 no aporta nada: usa también la versión AVX2
+inline int ProbeGroup(const int* group, const int key, const int empty) {
+#ifdef SPARSE_SIMD_X86
+  if (GetSimdLevel() >= kSimdAvx2)
+    return ProbeGroupAvx2(group, key, empty);
+#endif
+  return ProbeGroupScalar(group, key, empty);
+}
+
+// Evaluación por Horner de c[0] + c[1] x + ... + c[n-1] x^(n-1) en los m
+// puntos x[0..m), un punto por carril. Cada vuelta lleva varios registros de
+// puntos a la vez para que las multiplicaciones de uno no esperen a las del
+// anterior. Las versiones vectoriales usan FMA, así que pueden diferir de la
+// escalar en el último bit.
+
+inline void HornerBatchScalar(const double* c, const int n, const double* x,
+                              const int m, double* out) {
+  if (n == 0) {
+    for (int j = 0; j < m; j++)
+      out[j] = 0.0;
+    return;
+  }
+  int j = 0;
+  for (; j + 4 <= m; j += 4) {
+    double a0 = c[n - 1], a1 = c[n - 1], a2 = c[n - 1], a3 = c[n - 1];
+    for (int i = n - 2; i >= 0; i--) {
+      a0 = a0 * x[j] + c[i];
+      a1 = a1 * x[j + 1] + c[i];
+      a2 = a2 * x[j + 2] + c[i];
+      a3 = a3 * x[j + 3] + c[i];
+    }
+    out[j] = a0;
+    out[j + 1] = a1;
+    out[j + 2] = a2;
+    out[j + 3] = a3;
+  }
+  for (; j < m; j++) {
+    double a = c[n - 1];
+    for (int i = n - 2; i >= 0; i--)
+      a = a * x[j] + c[i];
+    out[j] = a;
+  }
+}
+
+#ifdef SPARSE_SIMD_X86
+// HornerBatchAvx2 necesita FMA además de AVX2, y el nivel AVX2 no lo exige
+inline bool CpuHasFma(void) {
+  static const bool fma = (__builtin_cpu_init(), __builtin_cpu_supports("fma"));
+  return fma;
+}
+
+__attribute__((target("avx2,fma")))
+inline void HornerBatchAvx2(const double* c, const int n, const double* x,
+                            const int m, double* out) {
+  if (n == 0) {
+    HornerBatchScalar(c, n, x, m, out);
+    return;
+  }
+  const __m256d top = _mm256_set1_pd(c[n - 1]);
+  int j = 0;
+  for (; j + 16 <= m; j += 16) {
+    const __m256d x0 = _mm256_loadu_pd(x + j);
+    const __m256d x1 = _mm256_loadu_pd(x + j + 4);
+    const __m256d x2 = _mm256_loadu_pd(x + j + 8);
+    const __m256d x3 = _mm256_loadu_pd(x + j + 12);
+    __m256d a0 = top, a1 = top, a2 = top, a3 = top;
+    for (int i = n - 2; i >= 0; i--) {
+      const __m256d ci = _mm256_set1_pd(c[i]);
+      a0 = _mm256_fmadd_pd(a0, x0, ci);
+      a1 = _mm256_fmadd_pd(a1, x1, ci);
+      a2 = _mm256_fmadd_pd(a2, x2, ci);
+      a3 = _mm256_fmadd_pd(a3, x3, ci);
+    }
+    _mm256_storeu_pd(out + j, a0);
+    _mm256_storeu_pd(out + j + 4, a1);
+    _mm256_storeu_pd(out + j + 8, a2);
+    _mm256_storeu_pd(out + j + 12, a3);
+  }
+  for (; j + 4 <= m; j += 4) {
+    const __m256d xj = _mm256_loadu_pd(x + j);
+    __m256d a = top;
+    for (int i = n - 2; i >= 0; i--)
+      a = _mm256_fmadd_pd(a, xj, _mm256_set1_pd(c[i]));
+    _mm256_storeu_pd(out + j, a);
+  }
+  HornerBatchScalar(c, n, x + j, m - j, out + j);
+}
+
+__attribute__((target("avx512f")))
+inline void HornerBatchAvx512(const double* c, const int n, const double* x,
+                              const int m, double* out) {
+  if (n == 0) {
+    HornerBatchScalar(c, n, x, m, out);
+    return;
+  }
+  const __m512d top = _mm512_set1_pd(c[n - 1]);
+  int j = 0;
+  for (; j + 32 <= m; j += 32) {
+    const __m512d x0 = _mm512_loadu_pd(x + j);
+    const __m512d x1 = _mm512_loadu_pd(x + j + 8);
+    const __m512d x2 = _mm512_loadu_pd(x + j + 16);
+    const __m512d x3 = _mm512_loadu_pd(x + j + 24);
+    __m512d a0 = top, a1 = top, a2 = top, a3 = top;
+    for (int i = n - 2; i >= 0; i--) {
+      const __m512d ci = _mm512_set1_pd(c[i]);
+      a0 = _mm512_fmadd_pd(a0, x0, ci);
+      a1 = _mm512_fmadd_pd(a1, x1, ci);
+      a2 = _mm512_fmadd_pd(a2, x2, ci);
+      a3 = _mm512_fmadd_pd(a3, x3, ci);
+    }
+    _mm512_storeu_pd(out + j, a0);
+    _mm512_storeu_pd(out + j + 8, a1);
+    _mm512_storeu_pd(out + j + 16, a2);
+    _mm512_storeu_pd(out + j + 24, a3);
+  }
+  for (; j + 8 <= m; j += 8) {
+    const __m512d xj = _mm512_loadu_pd(x + j);
+    __m512d a = top;
+    for (int i = n - 2; i >= 0; i--)
+      a = _mm512_fmadd_pd(a, xj, _mm512_set1_pd(c[i]));
+    _mm512_storeu_pd(out + j, a);
+  }
+  HornerBatchScalar(c, n, x + j, m - j, out + j);
+}
+
+#endif  // SPARSE_SIMD_X86
+
+inline void HornerBatch(const double* c, const int n, const double* x,
+                        const int m, double* out) {
+  switch (GetSimdLevel()) {
+#ifdef SPARSE_SIMD_X86
+    case kSimdAvx512: HornerBatchAvx512(c, n, x, m, out); break;
+    case kSimdAvx2:
+      if (CpuHasFma())
+        HornerBatchAvx2(c, n, x, m, out);
+      else
+        HornerBatchScalar(c, n, x, m, out);
+      break;
+#endif
+    default:          HornerBatchScalar(c, n, x, m, out); break;
+  }
+}
+
+#endif  // SPARSE_SIMD_H_
@@ -5,23 +5,70 @@
 // ASIGNATURA: Algoritmos y Estructuras de Datos
 // PRÁCTICA Nº: 3
 // ESTILO: Google C++ Style Guide
-// COMENTARIOS:
+// COMENTARIOS: los índices y los valores no nulos se guardan en dos vectores
+// separados (estructura de arrays) en lugar de un vector de pair_t: un
+// pair_t<double> ocupa 16 bytes con el relleno y mezcla índices y valores,
+// mientras que así los bucles que recorren solo índices (búsquedas, mezclas)
+// o solo valores leen memoria contigua y se pueden vectorizar.
+// at(i) sigue devolviendo algo con get_inx()/get_val(): un pair_t por valor
+// en la versión constante y una referencia a la posición i
+// (sparse_pair_ref_t) en la otra.
 // 
 
 #ifndef SPARSE_VECTORT_H_
 #define SPARSE_VECTORT_H_
 
 #include <iostream>
+#include <algorithm>  // min
 #include <math.h>  // fabs
 
 #include "vector_t.h"
 #include "pair_t.h"
+#include "sparse_simd.h"
 
 #define EPS 1.0e-6
 
+// Si un operando tiene más de kGallopRatio veces los no nulos del otro, las
+// operaciones entre dispersos recorren el pequeño y buscan a saltos en el
+// grande en lugar de mezclar elemento a elemento
+const int kGallopRatio = 32;
+
 typedef pair_t<double> pair_double_t;
 typedef vector_t<pair_double_t> pair_vector_t;
 
+// Referencia al par (valor, índice) i de un sparse_vector_t
+class sparse_pair_ref_t {
+ public:
+  sparse_pair_ref_t(double& val, int& inx) : val_(val), inx_(inx) {}
+
+  // getters & setters, como pair_t
+  double get_val(void) const { return val_; }
+  int get_inx(void) const { return inx_; }
+  void set(const double val, const int inx) {
+    val_ = val;
+    inx_ = inx;
+  }
+
+  sparse_pair_ref_t& operator=(const pair_double_t& p) {
+    set(p.get_val(), p.get_inx());
+    return *this;
+  }
+  operator pair_double_t(void) const { return pair_double_t(val_, inx_); }
+
+  // E/S
+  std::ostream& write(std::ostream& os = std::cout) const {
+    return pair_double_t(val_, inx_).write(os);
+  }
+
+ private:
+  double& val_;
+  int& inx_;
+};
+
+std::ostream& operator<<(std::ostream& os, const sparse_pair_ref_t& p) {
+  return p.write(os);
+}
+
 class sparse_vector_t {
  public:
   // constructores
@@ -29,9 +76,11 @@ class sparse_vector_t {
   sparse_vector_t(const vector_t<double>&,
 		  const double = EPS); // constructor normal
   sparse_vector_t(const sparse_vector_t&);  // constructor de copia
+  sparse_vector_t(sparse_vector_t&&) noexcept;  // constructor de movimiento
 
-  // operador de asignación
+  // operadores de asignación
   sparse_vector_t& operator=(const sparse_vector_t&);
+  sparse_vector_t& operator=(sparse_vector_t&&) noexcept;
 
   // destructor
   ~sparse_vector_t();
@@ -41,22 +90,55 @@ class sparse_vector_t {
   int get_n(void) const;
 
   // getters-setters
-  pair_double_t& at(const int);
-  pair_double_t& operator[](const int);
+  sparse_pair_ref_t at(const int);
+  sparse_pair_ref_t operator[](const int);
   
   // getters constantes
-  const pair_double_t& at(const int) const;
-  const pair_double_t& operator[](const int) const;
+  pair_double_t at(const int) const;
+  pair_double_t operator[](const int) const;
+
+  // índices (crecientes) y valores de los get_nz() no nulos, para los bucles
+  // internos
+  const int* inx_data(void) const;
+  const double* val_data(void) const;
+
+  // operaciones. El resultado va en el último vector, cuyo buffer se reutiliza
+  // si tiene sitio; si es disperso no puede ser un operando (salvo en Scale)
+  // y no guarda los valores que no superan eps.
+  // z = this + w, z = this - w, z = a this + w, z = a this
+  void Add(const sparse_vector_t&, sparse_vector_t&,
+           const double = EPS) const;
+  void Subtract(const sparse_vector_t&, sparse_vector_t&,
+                const double = EPS) const;
+  void Axpy(const double, const sparse_vector_t&, sparse_vector_t&,
+            const double = EPS) const;
+  void Scale(const double, sparse_vector_t&, const double = EPS) const;
+  double Dot(const sparse_vector_t&) const;
+
+  // con vectores densos de tamaño get_n(): z = this + w, z = this - w,
+  // y = a this + y (z puede ser w)
+  void Add(const vector_t<double>&, vector_t<double>&) const;
+  void Subtract(const vector_t<double>&, vector_t<double>&) const;
+  void Axpy(const double, vector_t<double>&) const;
+  double Dot(const vector_t<double>&) const;
 
   // E/S
   void write(std::ostream& = std::cout) const;
 
  private:
-  pair_vector_t pv_;  // valores + índices
-  int nz_;            // nº de valores distintos de cero = tamaño del vector
-  int n_;             // tamaño del vector original
+  vector_t<int> inx_;     // índices de los no nulos
+  vector_t<double> val_;  // valores de los no nulos
+  int nz_;                // nº de valores distintos de cero = tamaño de inx_ y val_
+  int n_;                 // tamaño del vector original
 
+  void Axpby(const double, const double, const sparse_vector_t&,
+             sparse_vector_t&, const double) const;
+  static int Merge(const double, const sparse_vector_t&, const double,
+                   const sparse_vector_t&, const double, int*, double*);
+  static int GallopMerge(const double, const sparse_vector_t&, const double,
+                         const sparse_vector_t&, const double, int*, double*);
 
+  friend class sparse_accumulator_t;  // Freeze() rellena inx_ y val_
 };
 
   // bool IsNotZero(const double, const double = EPS) const;
@@ -64,38 +146,76 @@ bool IsNotZero(const double val, const double eps = EPS) {
   return fabs(val) > eps;
 }
 
-sparse_vector_t::sparse_vector_t(const int n) : pv_(n), nz_(0), n_(n) {}
+// Primera posición de inx[first..last) con índice >= key, que debe estar a
+// partir de first: se avanza a saltos de 1, 2, 4... y se termina con una
+// búsqueda binaria en el último salto, así que cuesta O(log d) si la
+// respuesta está d posiciones más allá.
+inline int GallopLowerBound(const int* inx, int first, const int last,
+                            const int key) {
+  int hi = first;
+  int step = 1;
+  while (hi < last && inx[hi] < key) {
+    first = hi + 1;
+    hi += step;
+    step *= 2;
+  }
+  return std::lower_bound(inx + first, inx + std::min(hi, last), key) - inx;
+}
+
+sparse_vector_t::sparse_vector_t(const int n)
+    : inx_(), val_(), nz_(0), n_(n) {}
 
 // FASE II
+// Dos pasadas vectoriales sobre v: CountNonZeros cuenta con comparaciones y
+// máscaras, sin saltos, para reservar justo lo necesario, y CompressNonZeros
+// copia los no nulos de una vez. Sale más barato que ir ampliando la reserva
+// en una sola pasada, que obliga a copiar y a tocar memoria nueva en cada
+// ampliación.
 sparse_vector_t::sparse_vector_t(const vector_t<double>& v, const double eps)
-    : pv_(), nz_(0), n_(0) {
-  n_ = v.get_size();
-
-  for (int i = 0; i < n_; i++) {
-    if (IsNotZero(v.at(i), eps))
-      nz_++;
-  }
-
-  pv_.resize(nz_);
-  int j = 0;
-  for (int i = 0; i < n_; i++) {
-    if (IsNotZero(v.at(i), eps)) {
-      pv_.at(j).set(v.at(i), i);
-      j++;
-    }
-  }
+    : inx_(), val_(), nz_(0), n_(v.get_size()) {
+  const double* x = v.data();
+  nz_ = CountNonZeros(x, n_, eps);
+  const int room = std::min(nz_ + kCompressSlack, n_);
+  inx_.resize(room);
+  val_.resize(room);
+  const int nz = CompressNonZeros(x, n_, 0, eps, inx_.data(), val_.data());
+  assert(nz == nz_);
+  inx_.resize(nz_);
+  val_.resize(nz_);
 }
 
 // constructor de copia
-sparse_vector_t::sparse_vector_t(const sparse_vector_t& w) {
+sparse_vector_t::sparse_vector_t(const sparse_vector_t& w)
+    : inx_(), val_(), nz_(0), n_(0) {
   *this = w;  // se invoca directamente al operator=
 }
 
+// constructor de movimiento
+sparse_vector_t::sparse_vector_t(sparse_vector_t&& w) noexcept
+    : inx_(std::move(w.inx_)), val_(std::move(w.val_)), nz_(w.nz_),
+      n_(w.n_) {
+  w.nz_ = 0;
+  w.n_ = 0;
+}
+
 // operador de asignación
 sparse_vector_t& sparse_vector_t::operator=(const sparse_vector_t& w) {
   nz_ = w.get_nz();
   n_ = w.get_n();
-  pv_ = w.pv_;
+  inx_ = w.inx_;
+  val_ = w.val_;
+
+  return *this;
+}
+
+// operador de asignación por movimiento
+sparse_vector_t& sparse_vector_t::operator=(sparse_vector_t&& w) noexcept {
+  nz_ = w.nz_;
+  n_ = w.n_;
+  inx_ = std::move(w.inx_);
+  val_ = std::move(w.val_);
+  w.nz_ = 0;
+  w.n_ = 0;
 
   return *this;
 }
@@ -110,29 +230,243 @@ inline int sparse_vector_t::get_n() const {
   return n_;
 }
 
-pair_double_t& sparse_vector_t::at(const int i) {
+sparse_pair_ref_t sparse_vector_t::at(const int i) {
   assert(i >= 0 && i < get_nz());
-  return pv_[i];
+  return sparse_pair_ref_t(val_[i], inx_[i]);
 }
 
-pair_double_t& sparse_vector_t::operator[](const int i) {
+sparse_pair_ref_t sparse_vector_t::operator[](const int i) {
   return at(i);
 }
 
-const pair_double_t& sparse_vector_t::at(const int i) const {
+pair_double_t sparse_vector_t::at(const int i) const {
   assert(i >= 0 && i < get_nz());
-  return pv_[i];
+  return pair_double_t(val_[i], inx_[i]);
 }
 
-const pair_double_t& sparse_vector_t::operator[](const int i) const {
+pair_double_t sparse_vector_t::operator[](const int i) const {
   return at(i);
 }
 
+inline const int* sparse_vector_t::inx_data(void) const {
+  return inx_.data();
+}
+
+inline const double* sparse_vector_t::val_data(void) const {
+  return val_.data();
+}
+
+// FASE III: operaciones
+
+// z = a x + b y mezclando los índices de x e y. Se escribe siempre en z y
+// solo se avanza si el valor supera eps.
+int sparse_vector_t::Merge(const double a, const sparse_vector_t& x,
+                           const double b, const sparse_vector_t& y,
+                           const double eps, int* zi, double* zv) {
+  const int* xi = x.inx_data();
+  const double* xv = x.val_data();
+  const int* yi = y.inx_data();
+  const double* yv = y.val_data();
+  int i = 0, j = 0, k = 0;
+  while (i < x.get_nz() && j < y.get_nz()) {
+    if (xi[i] == yi[j]) {
+      zi[k] = xi[i];
+      zv[k] = a * xv[i++] + b * yv[j++];
+    } else if (xi[i] < yi[j]) {
+      zi[k] = xi[i];
+      zv[k] = a * xv[i++];
+    } else {
+      zi[k] = yi[j];
+      zv[k] = b * yv[j++];
+    }
+    k += IsNotZero(zv[k], eps);
+  }
+  for (; i < x.get_nz(); i++) {
+    zi[k] = xi[i];
+    zv[k] = a * xv[i];
+    k += IsNotZero(zv[k], eps);
+  }
+  for (; j < y.get_nz(); j++) {
+    zi[k] = yi[j];
+    zv[k] = b * yv[j];
+    k += IsNotZero(zv[k], eps);
+  }
+  return k;
+}
+
+// Como Merge, con x mucho más corto que y: para cada índice de x se busca a
+// saltos su sitio en y, y el tramo de y que queda antes se copia sin
+// comparar índices.
+int sparse_vector_t::GallopMerge(const double a, const sparse_vector_t& x,
+                                 const double b, const sparse_vector_t& y,
+                                 const double eps, int* zi, double* zv) {
+  const int* xi = x.inx_data();
+  const double* xv = x.val_data();
+  const int* yi = y.inx_data();
+  const double* yv = y.val_data();
+  int j = 0, k = 0;
+  for (int i = 0; i < x.get_nz(); i++) {
+    const int p = GallopLowerBound(yi, j, y.get_nz(), xi[i]);
+    for (; j < p; j++) {
+      zi[k] = yi[j];
+      zv[k] = b * yv[j];
+      k += IsNotZero(zv[k], eps);
+    }
+    zi[k] = xi[i];
+    zv[k] = a * xv[i];
+    if (j < y.get_nz() && yi[j] == xi[i])
+      zv[k] += b * yv[j++];
+    k += IsNotZero(zv[k], eps);
+  }
+  for (; j < y.get_nz(); j++) {
+    zi[k] = yi[j];
+    zv[k] = b * yv[j];
+    k += IsNotZero(zv[k], eps);
+  }
+  return k;
+}
+
+// z = a this + b w
+void sparse_vector_t::Axpby(const double a, const double b,
+                            const sparse_vector_t& w, sparse_vector_t& z,
+                            const double eps) const {
+  assert(get_n() == w.get_n());
+  assert(&z != this && &z != &w);
+  z.n_ = get_n();
+  z.inx_.resize(get_nz() + w.get_nz());
+  z.val_.resize(get_nz() + w.get_nz());
+  int* zi = z.inx_.data();
+  double* zv = z.val_.data();
+  if (static_cast<long>(get_nz()) * kGallopRatio < w.get_nz())
+    z.nz_ = GallopMerge(a, *this, b, w, eps, zi, zv);
+  else if (static_cast<long>(w.get_nz()) * kGallopRatio < get_nz())
+    z.nz_ = GallopMerge(b, w, a, *this, eps, zi, zv);
+  else
+    z.nz_ = Merge(a, *this, b, w, eps, zi, zv);
+  z.inx_.resize(z.nz_);
+  z.val_.resize(z.nz_);
+}
+
+void sparse_vector_t::Add(const sparse_vector_t& w, sparse_vector_t& z,
+                          const double eps) const {
+  Axpby(1.0, 1.0, w, z, eps);
+}
+
+void sparse_vector_t::Subtract(const sparse_vector_t& w, sparse_vector_t& z,
+                               const double eps) const {
+  Axpby(1.0, -1.0, w, z, eps);
+}
+
+void sparse_vector_t::Axpy(const double a, const sparse_vector_t& w,
+                           sparse_vector_t& z, const double eps) const {
+  Axpby(a, 1.0, w, z, eps);
+}
+
+// z puede ser this: se escribe siempre detrás de lo que se lee
+void sparse_vector_t::Scale(const double a, sparse_vector_t& z,
+                            const double eps) const {
+  z.n_ = get_n();
+  z.inx_.resize(get_nz());
+  z.val_.resize(get_nz());
+  int* zi = z.inx_.data();
+  double* zv = z.val_.data();
+  const int* xi = inx_data();
+  const double* xv = val_data();
+  int k = 0;
+  for (int i = 0; i < get_nz(); i++) {
+    zi[k] = xi[i];
+    zv[k] = a * xv[i];
+    k += IsNotZero(zv[k], eps);
+  }
+  z.nz_ = k;
+  z.inx_.resize(k);
+  z.val_.resize(k);
+}
+
+// Sin saltos en la mezcla: se avanza en x, en y o en los dos según el orden
+// de los índices actuales, y se suma el producto solo si coinciden.
+double sparse_vector_t::Dot(const sparse_vector_t& w) const {
+  assert(get_n() == w.get_n());
+  const sparse_vector_t& x = (get_nz() <= w.get_nz()) ? *this : w;
+  const sparse_vector_t& y = (get_nz() <= w.get_nz()) ? w : *this;
+  const int* xi = x.inx_data();
+  const double* xv = x.val_data();
+  const int* yi = y.inx_data();
+  const double* yv = y.val_data();
+  double result = 0.0;
+  if (static_cast<long>(x.get_nz()) * kGallopRatio < y.get_nz()) {
+    int j = 0;
+    for (int i = 0; i < x.get_nz() && j < y.get_nz(); i++) {
+      j = GallopLowerBound(yi, j, y.get_nz(), xi[i]);
+      if (j < y.get_nz() && yi[j] == xi[i])
+        result += xv[i] * yv[j++];
+    }
+    return result;
+  }
+  int i = 0, j = 0;
+  while (i < x.get_nz() && j < y.get_nz()) {
+    const int u = xi[i];
+    const int v = yi[j];
+    result += (u == v) ? xv[i] * yv[j] : 0.0;
+    i += u <= v;
+    j += v <= u;
+  }
+  return result;
+}
+
+void sparse_vector_t::Add(const vector_t<double>& w,
+                          vector_t<double>& z) const {
+  assert(w.get_size() == get_n());
+  z.resize(get_n());
+  const double* wv = w.data();
+  double* zv = z.data();
+  for (int k = 0; k < get_n(); k++)
+    zv[k] = wv[k];
+  const int* xi = inx_data();
+  const double* xv = val_data();
+  for (int i = 0; i < get_nz(); i++)
+    zv[xi[i]] += xv[i];
+}
+
+void sparse_vector_t::Subtract(const vector_t<double>& w,
+                               vector_t<double>& z) const {
+  assert(w.get_size() == get_n());
+  z.resize(get_n());
+  const double* wv = w.data();
+  double* zv = z.data();
+  for (int k = 0; k < get_n(); k++)
+    zv[k] = -wv[k];
+  const int* xi = inx_data();
+  const double* xv = val_data();
+  for (int i = 0; i < get_nz(); i++)
+    zv[xi[i]] += xv[i];
+}
+
+void sparse_vector_t::Axpy(const double a, vector_t<double>& y) const {
+  assert(y.get_size() == get_n());
+  const int* xi = inx_data();
+  const double* xv = val_data();
+  double* yv = y.data();
+  for (int i = 0; i < get_nz(); i++)
+    yv[xi[i]] += a * xv[i];
+}
+
+double sparse_vector_t::Dot(const vector_t<double>& w) const {
+  assert(w.get_size() == get_n());
+  const int* xi = inx_data();
+  const double* xv = val_data();
+  const double* wv = w.data();
+  double result = 0.0;
+  for (int i = 0; i < get_nz(); i++)
+    result += xv[i] * wv[xi[i]];
+  return result;
+}
+
 // E/S
 void sparse_vector_t::write(std::ostream& os) const { 
   os << get_n() << "(" << get_nz() << "): [ ";
   for (int i = 0; i < get_nz(); i++) {
-    os << pv_[i] << " ";
+    os << at(i) << " ";
   }
   os << "]" << std::endl;
 }
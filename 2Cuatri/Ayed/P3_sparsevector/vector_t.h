@@ -13,15 +13,18 @@
 
 #include <iostream>
 #include <cassert>
+#include <utility>
 
 template<class T> class vector_t {
  public:
   // constructores
   vector_t(const int = 0);
   vector_t(const vector_t&); // constructor de copia
+  vector_t(vector_t&&) noexcept; // constructor de movimiento
 
-  // operador de asignación
+  // operadores de asignación
   vector_t<T>& operator=(const vector_t<T>&);
+  vector_t<T>& operator=(vector_t<T>&&) noexcept;
 
   // destructor
   ~vector_t();
@@ -41,6 +44,10 @@ template<class T> class vector_t {
   const T& at(const int) const;
   const T& operator[](const int) const;
 
+  // acceso al buffer contiguo, para los bucles internos
+  T* data(void);
+  const T* data(void) const;
+
   // Redimensionado
   void resize(const int);
   
@@ -51,22 +58,32 @@ template<class T> class vector_t {
  private:
   T *v_;
   int sz_;
+  int cap_;  // elementos reservados en v_ (cap_ >= sz_)
   
   void build(void);
   void destroy(void);
 };
 
 
-template<class T> vector_t<T>::vector_t(const int n) : v_(NULL), sz_(n) {
+template<class T> vector_t<T>::vector_t(const int n)
+    : v_(NULL), sz_(n), cap_(0) {
   build();
 }
 
 // constructor de copia
 template<class T> vector_t<T>::vector_t(const vector_t<T>& w)
-    : v_(NULL), sz_(0) {
+    : v_(NULL), sz_(0), cap_(0) {
   *this = w; // se invoca directamente al operator=
 }
 
+// constructor de movimiento: se queda con el buffer de w, que queda vacío
+template<class T> vector_t<T>::vector_t(vector_t<T>&& w) noexcept
+    : v_(w.v_), sz_(w.sz_), cap_(w.cap_) {
+  w.v_ = NULL;
+  w.sz_ = 0;
+  w.cap_ = 0;
+}
+
 // operador de asignación
 template<class T> vector_t<T>& vector_t<T>::operator=(const vector_t<T>& w) {
   resize(w.get_size());
@@ -76,12 +93,25 @@ template<class T> vector_t<T>& vector_t<T>::operator=(const vector_t<T>& w) {
   return *this;
 }
 
+// operador de asignación por movimiento
+template<class T>
+vector_t<T>& vector_t<T>::operator=(vector_t<T>&& w) noexcept {
+  if (this != &w) {
+    destroy();
+    std::swap(v_, w.v_);
+    std::swap(sz_, w.sz_);
+    std::swap(cap_, w.cap_);
+  }
+  return *this;
+}
+
 template<class T> vector_t<T>::~vector_t() {
   destroy();
 }
 
 template<class T> void vector_t<T>::build() {
   v_ = NULL;
+  cap_ = sz_;
   if (sz_ != 0) {
     v_ = new T[sz_];
     assert(v_ != NULL);
@@ -94,9 +124,16 @@ template<class T> void vector_t<T>::destroy() {
     v_ = NULL;
   }
   sz_ = 0;
+  cap_ = 0;
 }
 
+// Reutiliza el buffer si tiene sitio para n elementos; si no, reserva uno
+// nuevo. En ambos casos el contenido no se conserva.
 template<class T> void vector_t<T>::resize(const int n) {
+  if (n <= cap_) {
+    sz_ = n;
+    return;
+  }
   destroy();
   sz_ = n;
   build();
@@ -134,6 +171,14 @@ template<class T> const T& vector_t<T>::operator[](const int i) const {
   return at(i);
 }
 
+template<class T> inline T* vector_t<T>::data(void) {
+  return v_;
+}
+
+template<class T> inline const T* vector_t<T>::data(void) const {
+  return v_;
+}
+
 template<class T> void vector_t<T>::read(std::istream& is) {
   is >> sz_;
   resize(sz_);